@@ -0,0 +1,527 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <new>
+#include <random>
+
+#include "args/args.h"
+#include "args/spec.h"
+
+namespace {
+// Number of heap allocations so far (the benchmark is single threaded)
+std::size_t num_allocations = 0;
+
+void* allocate(std::size_t size) {
+    num_allocations++;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc {};
+}
+} // namespace
+
+// Every allocation goes through here, so that it can be accounted
+void* operator new(std::size_t size) {
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// The scenario has no allocation budget
+constexpr std::size_t NO_BUDGET = std::numeric_limits<std::size_t>::max();
+
+// Whether any scenario exceeded its allocation budget
+bool over_budget = false;
+
+// Sizes of the synthetic specs
+constexpr unsigned int SPEC_SIZES[] = {10, 100, 1000, 10000};
+
+// Fixed seed, so that every run measures the same inputs
+constexpr unsigned int SEED = 42;
+
+// Discards everything: only the rendering is measured
+class NullSink : public Args::IOutputSink {
+public:
+    void write(const char*, std::size_t size) override {
+        written += size;
+    }
+
+    std::size_t written {};
+};
+
+/*
+ * Parser with num_options synthetic int options ('--option-<i>'),
+ * each one bound to its own value.
+ */
+struct SyntheticSpec {
+    explicit SyntheticSpec(unsigned int num_options) {
+        values.resize(num_options);
+        names.reserve(num_options);
+        helps.reserve(num_options);
+        for (unsigned int i = 0; i < num_options; i++) {
+            names.push_back("--option-" + std::to_string(i));
+            helps.push_back("Synthetic option number " + std::to_string(i));
+            arguments.push_back(&parser.add_argument(values[i], names[i]).help(helps[i]));
+        }
+        parser.freeze();
+    }
+
+    // Same description of the parser's help
+    std::vector<Args::HelpEntry> help_entries() const {
+        std::vector<Args::HelpEntry> entries {};
+        for (std::size_t i = 0; i < names.size(); i++) {
+            entries.push_back({{names[i]}, helps[i], 1, 1, false});
+        }
+        return entries;
+    }
+
+    Args::Parser parser {};
+    std::vector<const Args::ArgumentConfig*> arguments {};
+    std::deque<int> values {};
+    std::vector<std::string> names {};
+    std::vector<std::string> helps {};
+};
+
+// Size of the compile time spec: far more options than a seed search could ever hash perfectly
+constexpr std::size_t STATIC_SPEC_SIZE = 128;
+
+// Names of N synthetic options ('--option-<i>'), written while compiling
+template <std::size_t N>
+struct StaticOptionNames {
+    constexpr StaticOptionNames() {
+        constexpr std::string_view prefix = "--option-";
+        for (std::size_t i = 0; i < N; i++) {
+            std::size_t size = 0;
+            for (const char c : prefix) {
+                buffers[i][size++] = c;
+            }
+            char digits[8] {};
+            std::size_t num_digits = 0;
+            for (std::size_t n = i; num_digits == 0 || n; n /= 10) {
+                digits[num_digits++] = static_cast<char>('0' + n % 10);
+            }
+            while (num_digits) {
+                buffers[i][size++] = digits[--num_digits];
+            }
+            sizes[i] = size;
+        }
+    }
+
+    constexpr std::string_view operator[](std::size_t i) const {
+        return {buffers[i], sizes[i]};
+    }
+
+    char buffers[N][24] {};
+    std::size_t sizes[N] {};
+};
+
+constexpr StaticOptionNames<STATIC_SPEC_SIZE> static_option_names {};
+
+template <std::size_t... Is>
+constexpr auto make_static_spec(std::index_sequence<Is...>) {
+    return Args::make_spec(Args::static_argument<int>(static_option_names[Is])...);
+}
+
+// Compile time counterpart of SyntheticSpec
+constexpr auto static_spec = make_static_spec(std::make_index_sequence<STATIC_SPEC_SIZE> {});
+
+template <std::size_t... Is>
+bool static_parse(std::array<int, STATIC_SPEC_SIZE>& values, unsigned int argc, char** argv,
+                  std::index_sequence<Is...>) {
+    Args::StaticParser<static_spec> parser {values[Is]...};
+    return parser.parse(argc, argv, 1);
+}
+
+// Command line as argv, backed by its own strings
+struct CommandLine {
+    void push_back(std::string token) {
+        tokens.push_back(std::move(token));
+    }
+
+    char** argv() {
+        pointers.clear();
+        for (auto& token : tokens) {
+            pointers.push_back(token.data());
+        }
+        return pointers.data();
+    }
+
+    unsigned int argc() const {
+        return static_cast<unsigned int>(tokens.size());
+    }
+
+    std::vector<std::string> tokens {};
+    std::vector<char*> pointers {};
+};
+
+/*
+ * Runs the scenario the given number of times (after a warm up)
+ * and prints the percentiles of the latency of a single run.
+ * Each run performs ops operations, used to compute the throughput,
+ * and must not allocate more than budget times (once warmed up).
+ */
+void measure(const char* name, unsigned int iterations, std::size_t ops, std::size_t budget,
+             const std::function<void()>& run) {
+    std::vector<double> samples(iterations);
+    std::size_t max_allocations = 0;
+
+    for (unsigned int i = 0; i < std::max(iterations / 10, 1U); i++) {
+        run();
+    }
+
+    for (unsigned int i = 0; i < iterations; i++) {
+        const std::size_t allocations = num_allocations;
+        const auto begin = Clock::now();
+        run();
+        samples[i] = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+        max_allocations = std::max(max_allocations, num_allocations - allocations);
+    }
+
+    std::sort(samples.begin(), samples.end());
+    const auto percentile = [&samples](double p) {
+        return samples[std::min(static_cast<std::size_t>(p * samples.size()), samples.size() - 1)];
+    };
+
+    const double p50 = percentile(0.5);
+    std::printf("%-36s %12.0f %12.0f %12.0f %12.0f %14.0f %8zu", name, p50, percentile(0.9), percentile(0.99),
+                samples.back(), p50 > 0 ? ops * 1e9 / p50 : 0.0, max_allocations);
+
+    if (max_allocations > budget) {
+        std::printf("  FAILED: allocation budget is %zu\n", budget);
+        over_budget = true;
+    } else {
+        std::printf("\n");
+    }
+}
+
+// Keeps the computation of value from being optimized away
+template <typename T>
+void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile T sink;
+    sink = value;
+    (void)sink;
+#endif
+}
+
+bool matches(const std::string& filter, const std::string& name) {
+    return filter.empty() || name.find(filter) != std::string::npos;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    using namespace Args;
+
+    struct {
+        unsigned int iterations {};
+        std::string filter {};
+    } args {100, {}};
+
+    Parser bench_parser {};
+    bench_parser.add_argument(args.iterations, "--iterations", "-n").help("Runs of each scenario (default 100)");
+    bench_parser.add_argument(args.filter, "--filter", "-f").help("Only run the scenarios containing this string");
+
+    if (!bench_parser.parse(argc, argv, 1)) {
+        return 1;
+    }
+
+    const unsigned int iterations = std::max(args.iterations, 1U);
+
+    std::printf("%-36s %12s %12s %12s %12s %14s %8s\n", "scenario", "p50 (ns)", "p90 (ns)", "p99 (ns)", "max (ns)",
+                "ops/s", "allocs");
+
+    std::string name {};
+
+    // Parser construction (it always adds the help argument)
+    if (matches(args.filter, "construct")) {
+        measure("construct", iterations, 1, NO_BUDGET, [] {
+            Parser parser {};
+            (void)parser;
+        });
+    }
+
+    for (const unsigned int n : SPEC_SIZES) {
+        // Setup of a spec of n options, including its freeze
+        name = "add_argument/" + std::to_string(n);
+        if (matches(args.filter, name)) {
+            std::vector<std::string> names {};
+            for (unsigned int i = 0; i < n; i++) {
+                names.push_back("--option-" + std::to_string(i));
+            }
+            std::deque<int> values(n);
+
+            measure(name.c_str(), iterations, n, NO_BUDGET, [&] {
+                Parser parser {};
+                for (unsigned int i = 0; i < n; i++) {
+                    parser.add_argument(values[i], names[i]);
+                }
+                parser.freeze();
+            });
+        }
+
+        // Startup of a tool with n commands: only the parser of the one invoked is set up
+        name = "dispatch/" + std::to_string(n);
+        if (matches(args.filter, name)) {
+            std::vector<std::string> paths {};
+            for (unsigned int i = 0; i < n; i++) {
+                paths.push_back("group-" + std::to_string(i % 10) + " command-" + std::to_string(i));
+            }
+            CommandLine line {};
+            line.push_back("program");
+            line.push_back("group-" + std::to_string((n - 1) % 10));
+            line.push_back("command-" + std::to_string(n - 1));
+            line.push_back("--value");
+            line.push_back("1");
+            char** line_argv = line.argv();
+            int value {};
+
+            measure(name.c_str(), iterations, 1, NO_BUDGET, [&] {
+                Parser parser {};
+                for (const auto& path : paths) {
+                    parser.add_command(path, "Synthetic command", [&value](Parser& command) {
+                        command.add_argument(value, "--value");
+                    });
+                }
+                parser.parse(line.argc(), line_argv, 1);
+            });
+        }
+
+        const bool parse_small = matches(args.filter, "parse_small/" + std::to_string(n));
+        const bool parse_huge = matches(args.filter, "parse_huge/" + std::to_string(n));
+        const bool validate = matches(args.filter, "validate/" + std::to_string(n));
+        const bool get = matches(args.filter, "get/" + std::to_string(n));
+        const bool reject = matches(args.filter, "reject/" + std::to_string(n));
+        const bool render = matches(args.filter, "render_help/" + std::to_string(n));
+        const bool help = matches(args.filter, "print_help/" + std::to_string(n));
+        if (!parse_small && !parse_huge && !validate && !get && !reject && !render && !help) {
+            continue;
+        }
+
+        SyntheticSpec spec {n};
+        std::mt19937 rng {SEED};
+        std::uniform_int_distribution<unsigned int> option {0, n - 1};
+        std::uniform_int_distribution<int> value {-1000000, 1000000};
+
+        // A typical command line: a few random options
+        if (parse_small) {
+            name = "parse_small/" + std::to_string(n);
+            CommandLine line {};
+            line.push_back("program");
+            for (unsigned int i = 0; i < 4; i++) {
+                line.push_back(spec.names[option(rng)]);
+                line.push_back(std::to_string(value(rng)));
+            }
+            char** line_argv = line.argv();
+
+            // Binding numbers never allocates
+            measure(name.c_str(), iterations, 1, 0, [&] {
+                spec.parser.parse(line.argc(), line_argv, 1);
+            });
+        }
+
+        // Every option of the spec, in random order
+        if (parse_huge || validate || get) {
+            std::vector<unsigned int> order(n);
+            for (unsigned int i = 0; i < n; i++) {
+                order[i] = i;
+            }
+            std::shuffle(order.begin(), order.end(), rng);
+
+            CommandLine line {};
+            line.push_back("program");
+            for (const unsigned int i : order) {
+                line.push_back(spec.names[i]);
+                line.push_back(std::to_string(value(rng)));
+            }
+            char** line_argv = line.argv();
+
+            if (parse_huge) {
+                name = "parse_huge/" + std::to_string(n);
+                measure(name.c_str(), iterations, n, 0, [&] {
+                    spec.parser.parse(line.argc(), line_argv, 1);
+                });
+            }
+
+            // Validation into a reused state, without binding
+            if (validate) {
+                name = "validate/" + std::to_string(n);
+                ParseState state {};
+                measure(name.c_str(), iterations, n, 0, [&] {
+                    spec.parser.parse(line.argc(), line_argv, state, 1);
+                });
+            }
+
+            // Conversion of the validated values, one by one
+            if (get) {
+                name = "get/" + std::to_string(n);
+                ParseState state {};
+                spec.parser.parse(line.argc(), line_argv, state, 1);
+                measure(name.c_str(), iterations, n, 0, [&] {
+                    int sum = 0;
+                    for (const auto* arg : spec.arguments) {
+                        int value {};
+                        state.get(*arg, value);
+                        sum ^= value;
+                    }
+                    do_not_optimize(sum);
+                });
+            }
+        }
+
+        // Malformed command lines: the errors are reported without allocating
+        if (reject) {
+            name = "reject/" + std::to_string(n);
+            CommandLine line {};
+            line.push_back("program");
+            line.push_back(spec.names[option(rng)]);
+            line.push_back("not-a-number");
+            char** line_argv = line.argv();
+
+            ParseState state {};
+            measure(name.c_str(), iterations, 1, 0, [&] {
+                spec.parser.parse(line.argc(), line_argv, state, 1);
+            });
+        }
+
+        // Rendering from scratch
+        if (render) {
+            name = "render_help/" + std::to_string(n);
+            const std::vector<HelpEntry> entries = spec.help_entries();
+            measure(name.c_str(), iterations, 1, NO_BUDGET, [&] {
+                render_help(entries, DEFAULT_HELP_WIDTH);
+            });
+        }
+
+        // Once rendered, the help is written straight from the cache
+        if (help) {
+            name = "print_help/" + std::to_string(n);
+            NullSink sink {};
+            measure(name.c_str(), iterations, 1, 0, [&] {
+                spec.parser.print_help(sink, DEFAULT_HELP_WIDTH);
+            });
+        }
+    }
+
+    // Every option of the compile time spec, in random order
+    name = "static_parse/" + std::to_string(STATIC_SPEC_SIZE);
+    if (matches(args.filter, name)) {
+        std::mt19937 rng {SEED};
+        std::uniform_int_distribution<int> value {-1000000, 1000000};
+
+        std::vector<std::size_t> order(STATIC_SPEC_SIZE);
+        for (std::size_t i = 0; i < STATIC_SPEC_SIZE; i++) {
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), rng);
+
+        CommandLine line {};
+        line.push_back("program");
+        for (const std::size_t i : order) {
+            line.push_back(std::string {static_option_names[i]});
+            line.push_back(std::to_string(value(rng)));
+        }
+        char** line_argv = line.argv();
+
+        std::array<int, STATIC_SPEC_SIZE> values {};
+        measure(name.c_str(), iterations, STATIC_SPEC_SIZE, 0, [&] {
+            if (!static_parse(values, line.argc(), line_argv, std::make_index_sequence<STATIC_SPEC_SIZE> {})) {
+                std::printf("%s: unexpected parse failure\n", name.c_str());
+                std::exit(1);
+            }
+        });
+    }
+
+    // Conversion of numbers, in the bases accepted by parse_number()
+    {
+        constexpr unsigned int NUM_VALUES = 10000;
+        std::mt19937 rng {SEED};
+
+        if (matches(args.filter, "parse_number/int")) {
+            std::uniform_int_distribution<int> value {std::numeric_limits<int>::min(),
+                                                      std::numeric_limits<int>::max()};
+            std::vector<std::string> tokens {};
+            for (unsigned int i = 0; i < NUM_VALUES; i++) {
+                tokens.push_back(std::to_string(value(rng)));
+            }
+
+            measure("parse_number/int", iterations, NUM_VALUES, 0, [&] {
+                int sum = 0;
+                for (const auto& token : tokens) {
+                    int n {};
+                    parse_number(token, n);
+                    sum ^= n;
+                }
+                do_not_optimize(sum);
+            });
+        }
+
+        if (matches(args.filter, "parse_number/hex")) {
+            std::uniform_int_distribution<unsigned int> value {};
+            std::vector<std::string> tokens {};
+            char buffer[16];
+            for (unsigned int i = 0; i < NUM_VALUES; i++) {
+                std::snprintf(buffer, sizeof(buffer), "0x%x", value(rng));
+                tokens.emplace_back(buffer);
+            }
+
+            measure("parse_number/hex", iterations, NUM_VALUES, 0, [&] {
+                unsigned int sum = 0;
+                for (const auto& token : tokens) {
+                    unsigned int n {};
+                    parse_number(token, n);
+                    sum ^= n;
+                }
+                do_not_optimize(sum);
+            });
+        }
+
+        if (matches(args.filter, "parse_number/double")) {
+            std::uniform_real_distribution<double> value {-1e6, 1e6};
+            std::vector<std::string> tokens {};
+            char buffer[32];
+            for (unsigned int i = 0; i < NUM_VALUES; i++) {
+                std::snprintf(buffer, sizeof(buffer), "%.6f", value(rng));
+                tokens.emplace_back(buffer);
+            }
+
+            measure("parse_number/double", iterations, NUM_VALUES, 0, [&] {
+                double sum = 0;
+                for (const auto& token : tokens) {
+                    double n {};
+                    parse_number(token, n);
+                    sum += n;
+                }
+                do_not_optimize(sum);
+            });
+        }
+    }
+
+    return over_budget ? 1 : 0;
+}
@@ -1,42 +1,211 @@
 #ifndef ARGS_H
 #define ARGS_H
 
-#include <iomanip>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <system_error>
 #include <unordered_map>
+#include <variant>
 #include <vector>
 
 namespace Args {
+// FNV-1a with a final avalanche, so that the low bits are usable as index
+constexpr std::uint32_t hash_name(std::string_view s, std::uint32_t seed = 0) {
+    std::uint32_t h = 2166136261u ^ seed;
+    for (char c : s) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    return h;
+}
+
+// Maximum number of parameters of an argument without an upper bound
+constexpr unsigned int UNBOUNDED_PARAMS = std::numeric_limits<unsigned int>::max();
+
+// Token after which all the others are positional arguments, even if they look like options
+constexpr std::string_view OPTIONS_TERMINATOR = "--";
+
+// Index of a missing token or argument
+constexpr unsigned int NO_INDEX = std::numeric_limits<unsigned int>::max();
+
+enum class ParseErrorCode : std::uint8_t {
+    // Setup errors
+    EmptyName,
+    MixedNames,
+    InvalidNargs,
+    NotFrozen,
+
+    // Parse errors
+    UnknownArgument,
+    AmbiguousArgument,
+    MissingParameter,
+    UnexpectedParameter,
+    MissingRequiredArgument,
+    InvalidNumber,
+    NumberOutOfRange,
+    UnknownCommand,
+    MissingCommand,
+
+    // Reported by user defined arguments, with their own message
+    Custom,
+};
+
+/*
+ * A structured error: the message is only rendered on demand, by format_error().
+ * The token is a view over the parsed tokens, which therefore must outlive the error
+ * (or the error must be persisted, see ParseErrors::persist()).
+ */
+struct ParseError {
+    ParseErrorCode code {};
+    unsigned int token_index {NO_INDEX};
+    unsigned int argument_index {NO_INDEX};
+    std::string_view token {};
+    std::string_view message {};
+};
+
+// Renders the message of error, given the name of the argument it refers to (if any)
+std::string format_error(const ParseError& error, std::string_view argument_name = {});
+
+/*
+ * Fixed capacity buffer of ParseError: neither building it nor adding an error allocates,
+ * except for the messages of Custom errors (and the persisted tokens).
+ * The errors exceeding the capacity are only counted.
+ */
+class ParseErrors {
+public:
+    static constexpr std::size_t CAPACITY = 8;
+
+    ParseErrors() = default;
+    ParseErrors(const ParseErrors&) = delete;
+    ParseErrors(ParseErrors&&) = default;
+    ParseErrors& operator=(const ParseErrors&) = delete;
+    ParseErrors& operator=(ParseErrors&&) = default;
+
+    void add(const ParseError& error);
+    void add(ParseError error, std::string&& message);
+    void clear();
+
+    // Copies the tokens of the errors into the buffer itself, so that they don't refer to the parsed tokens anymore
+    void persist();
+
+    bool empty() const;
+    std::size_t size() const;
+    // Number of the errors that didn't fit the buffer
+    std::size_t dropped() const;
+
+    const ParseError& operator[](std::size_t i) const;
+    const ParseError* begin() const;
+    const ParseError* end() const;
+
+private:
+    std::array<ParseError, CAPACITY> errors {};
+    std::size_t size_ {};
+    std::size_t dropped_ {};
+
+    std::deque<std::string>& owned_strings();
+
+    // Owned strings (custom messages and persisted tokens): elements of a deque never move.
+    // Allocated only when the first string is owned, since an empty deque allocates too.
+    std::unique_ptr<std::deque<std::string>> storage {};
+};
+
 class ArgumentConfig {
 public:
-    friend class Parser;
+    friend class ParserSpec;
+    friend class ParseState;
+    friend class IncrementalParser;
 
     explicit ArgumentConfig(std::vector<std::string>&& names);
 
     ArgumentConfig& required(bool req);
     ArgumentConfig& help(const std::string& h);
 
+    // Number of parameters of a std::vector argument (by default '+'):
+    // either '?' (0 or 1), '*' (0 or more), '+' (1 or more) or an exact count.
+    // Anything else is reported as a setup error.
+    ArgumentConfig& nargs(char n);
+    ArgumentConfig& nargs(int n);
+    ArgumentConfig& nargs(unsigned int n);
+
 protected:
     std::vector<std::string> names {};
     std::string help_ {};
     bool required_ {};
+
+    // Overridden by nargs()
+    bool nargs_ {};
+    bool invalid_nargs_ {};
+    unsigned int min_params_ {};
+    unsigned int max_params_ {};
+
+    // Dense index of the argument within its parser
+    unsigned int index {};
 };
 
 class ArgumentParseContext {
 public:
-    ArgumentParseContext(const std::vector<std::string>& argv, std::vector<std::string>& errors,
+    ArgumentParseContext(const char* const* argv, unsigned int argc, ParseErrors& errors, unsigned int index = 0);
+    ArgumentParseContext(const std::string_view* tokens, unsigned int count, ParseErrors& errors,
                          unsigned int index = 0);
 
     bool has_next(unsigned int n = 1) const;
-    const std::string& seek_next() const;
-    const std::string& pop_next();
+    std::string_view seek_next() const;
+    std::string_view pop_next();
+
+    // Reports an error about the last popped token
+    void add_error(ParseErrorCode code, unsigned int argument = NO_INDEX) const;
     void add_error(std::string&& error) const;
 
+    // Returns the token following the next one by offset, without consuming it
+    std::string_view peek(unsigned int offset) const;
+
+    // Number of the available tokens
+    unsigned int remaining() const;
+
+    // Restricts the available tokens to the next count (e.g. to the parameters of a variadic argument)
+    void set_limit(unsigned int count);
+    void reset_limit();
+
+    // Records every popped token into params (or stops recording, if null)
+    void record_params(std::vector<std::string_view>* params);
+
+    // Offset added to the token index of the reported errors (e.g. when tokens are a slice of the input)
+    void set_token_offset(unsigned int offset);
+
+    // Makes value the next token, ahead of the remaining ones (e.g. the value attached to an option, '-z2.0')
+    void attach(std::string_view value);
+
+    // Context over the remaining tokens, reporting into errors (e.g. to hand them to a command's parser)
+    ArgumentParseContext rest(ParseErrors& errors) const;
+
 private:
-    const std::vector<std::string>& argv;
-    std::vector<std::string>& errors;
+    // Non-owning view over either the original argv or a span of tokens: tokens are never copied
+    const char* const* argv {};
+    const std::string_view* tokens {};
+    unsigned int argc {};
+    ParseErrors& errors;
     unsigned int index {};
+    unsigned int end {};
+    unsigned int token_offset {};
+    std::vector<std::string_view>* params {};
+
+    std::string_view attached {};
+    bool has_attached {};
+
+    // Last popped token (the one errors refer to)
+    std::string_view last {};
+    unsigned int last_index {NO_INDEX};
 };
 
 class IParsableArgument {
@@ -48,50 +217,540 @@ public:
     virtual unsigned int num_params() const = 0;
 };
 
-class Argument : public IParsableArgument, public ArgumentConfig {
-public:
-    explicit Argument(std::vector<std::string>&& names);
-};
-
 template <typename T>
-class ArgumentImplT : public Argument {
+class ArgumentImplT : public IParsableArgument {
 public:
-    ArgumentImplT(T& data, std::vector<std::string>&& names);
+    explicit ArgumentImplT(T& data);
 
 protected:
     T& data {};
 };
 
+// Minimum number of parameters consumed by an argument of type T
+template <typename T>
+constexpr unsigned int argument_num_params();
+
+// Maximum number of parameters consumed by an argument of type T
+template <typename T>
+constexpr unsigned int argument_max_params();
+
+// Locale independent conversion of s to the number type T, with range checking.
+// Integers accept the 0x (hex), 0o (octal) and 0b (binary) prefixes.
+template <typename T>
+std::errc parse_number(std::string_view s, T& value);
+
+// Parses the next parameter(s) of the context into data.
+// Containers (std::vector, std::array) consume all the available tokens, see ArgumentParseContext::set_limit.
+template <typename T>
+void parse_argument(T& data, ArgumentParseContext& context);
+
+// Parses user defined types: can be specialized for custom types
 template <typename T>
 class ArgumentImpl : public ArgumentImplT<T> {
 public:
-    ArgumentImpl(T& data, std::vector<std::string> names);
+    explicit ArgumentImpl(T& data);
 
     void parse(ArgumentParseContext& context) override;
 
     unsigned int num_params() const override;
 };
 
-class Parser {
+// Bound std::vector or std::array of built-in types
+struct ContainerTarget {
+    void* container {};
+    void (*parse)(void* container, ArgumentParseContext& context) {};
+    void (*check)(ArgumentParseContext& context) {};
+    unsigned int min_params {};
+    unsigned int max_params {};
+    bool resizable {};
+};
+
+/*
+ * The bound target of an argument.
+ * Built-in types (and containers of them) are stored inline and dispatched without virtual calls,
+ * user defined types go through an IParsableArgument.
+ */
+using ArgumentTarget =
+    std::variant<std::monostate, bool*, std::string*, char*, signed char*, unsigned char*, short*, unsigned short*,
+                 int*, unsigned int*, long*, unsigned long*, long long*, unsigned long long*, float*, double*,
+                 long double*, ContainerTarget, std::unique_ptr<IParsableArgument>>;
+
+template <typename T>
+ArgumentTarget make_argument_target(T& data);
+
+class Argument : public ArgumentConfig {
+public:
+    Argument(std::vector<std::string>&& names, ArgumentTarget&& target);
+
+    // Parses the next parameter(s) into the bound target
+    void parse(ArgumentParseContext& context) const;
+
+    // Validates the next parameter(s) without touching the bound target
+    void check(ArgumentParseContext& context) const;
+
+    unsigned int min_params() const;
+    unsigned int max_params() const;
+
+private:
+    ArgumentTarget target;
+};
+
+/*
+ * Destination of the messages (help and errors) written by the parsers.
+ * Each message is rendered in full first, then written with a single call.
+ */
+class IOutputSink {
+public:
+    virtual ~IOutputSink() = default;
+
+    virtual void write(const char* data, std::size_t size) = 0;
+};
+
+// Unbuffered sink over a file descriptor
+class FileDescriptorSink : public IOutputSink {
+public:
+    explicit FileDescriptorSink(int fd);
+
+    void write(const char* data, std::size_t size) override;
+
+private:
+    int fd {};
+};
+
+// Default sinks of the help and of the errors
+IOutputSink& standard_output();
+IOutputSink& standard_error();
+
+// Width of the help when the terminal's one is unknown
+constexpr unsigned int DEFAULT_HELP_WIDTH = 80;
+
+// Width of the terminal of the standard output (or $COLUMNS, or DEFAULT_HELP_WIDTH),
+// detected once and then cached
+unsigned int terminal_width();
+
+// Description of an argument, as needed to render the help message
+struct HelpEntry {
+    std::vector<std::string_view> names {};
+    std::string_view help {};
+    unsigned int min_params {};
+    unsigned int max_params {};
+    bool required {};
+    // A command's path (see Parser::add_command()), rather than an argument
+    bool command {};
+};
+
+/*
+ * Everything of the help that doesn't depend on the width it's rendered for:
+ * the arguments in order, their parameters' names and the width of the names column.
+ * Views refer to the names and the help of the entries it's computed from.
+ */
+struct HelpLayout {
+    struct UsageEntry {
+        std::string_view name {};
+        std::optional<std::string> param_name {};
+        bool optional {};
+    };
+
+    struct PositionalEntry {
+        std::string_view name {};
+        std::string_view help {};
+    };
+
+    struct OptionEntry {
+        std::vector<std::string_view> names {};
+        std::optional<std::string> param_name {};
+        std::string_view help {};
+    };
+
+    std::vector<UsageEntry> usage {};
+    std::vector<PositionalEntry> positional_entries {};
+    std::vector<PositionalEntry> command_entries {};
+    std::vector<OptionEntry> option_entries {};
+    unsigned int args_col_width {};
+};
+
+HelpLayout layout_help(const std::vector<HelpEntry>& entries);
+
+std::string render_help(const HelpLayout& layout, unsigned int width);
+std::string render_help(const std::vector<HelpEntry>& entries, unsigned int width = terminal_width());
+
+void print_help(const std::vector<HelpEntry>& entries, IOutputSink& out = standard_output());
+
+/*
+ * The help rendered for a given width, kept as a single buffer
+ * and reused as long as it's printed for the same width.
+ * The layout is computed only once, for whatever width.
+ * Many threads can print from the same cache.
+ */
+class HelpCache {
+public:
+    // Writes the help (or only its usage line), laying out entries() only if not cached
+    template <typename Entries>
+    void print(unsigned int width, bool usage_only, Entries&& entries, IOutputSink& out);
+
+    void clear();
+
+private:
+    std::mutex mutex {};
+    std::optional<HelpLayout> layout {};
+    unsigned int width {};
+    std::string text {};
+    std::size_t usage_size {};
+};
+
+/*
+ * Flat open addressing table of the options' names,
+ * with precomputed hashes and linear probing,
+ * plus the sorted long names for the lookup by prefix.
+ */
+class OptionIndex {
+public:
+    void build(const std::unordered_map<std::string_view, const Argument*>& options);
+
+    const Argument* find(std::string_view name) const;
+
+    // Returns the option with a long name ('--name') starting with prefix, if it's the only one.
+    // ambiguous is set if more options match.
+    const Argument* find_prefix(std::string_view prefix, bool& ambiguous) const;
+
+    // Returns the option named '-c'
+    const Argument* find_short(char c) const;
+
+private:
+    struct Slot {
+        std::string_view name {};
+        const Argument* argument {};
+        std::uint32_t hash {};
+    };
+
+    std::vector<Slot> slots {};
+    std::size_t mask {};
+
+    std::vector<std::pair<std::string_view, const Argument*>> long_names {};
+
+    // Indexed by the character of the short names ('-c')
+    std::array<const Argument*, 256> short_names {};
+};
+
+class ParserSpec;
+class Parser;
+class Plugin;
+
+// Sets up the parser of a command (it's called only if the command is found)
+using CommandFactory = std::function<void(Parser& parser)>;
+
+/*
+ * Node of the trie of the commands, one level for each word of their path ('db migrate up').
+ * Only the nodes with a factory are commands: the others just group them.
+ */
+struct CommandNode {
+    std::string name {};
+    std::string path {};
+    std::string help {};
+    CommandFactory factory {};
+
+    // Loads the help on demand, if not given (e.g. from a plugin), the first time the help is laid out
+    std::function<std::string()> describe {};
+    mutable std::optional<std::string> described_help {};
+
+    // Sorted by name (views over the children's own names)
+    std::vector<std::pair<std::string_view, CommandNode*>> children {};
+
+    const CommandNode* find(std::string_view child_name) const;
+};
+
+// Where the grammar is within a command line (see TokenGrammar)
+struct GrammarState {
+    // Next positional argument to be parsed
+    unsigned int positional_index {};
+
+    // Whether the options terminator ('--') has been found
+    bool options_ended {};
+};
+
+/*
+ * The token grammar shared by all the parsers: options (with their value attached with '='),
+ * bundles of short options, commands, the options terminator and positional arguments.
+ * The parsers only differ in how they consume the parameters (binding, recording or buffering them)
+ * and in the lookups Derived provides, which may know only some of the grammar:
+ *
+ *     OptionMatch match_option(std::string_view token) const;
+ *     bool is_short_bundle(std::string_view token) const;
+ *     const CommandNode* find_command(std::string_view token) const;
+ *     const ArgumentType* positional(unsigned int index) const; // null after the last one
+ *
+ * ArgumentType provides min_params() and max_params().
+ */
+template <typename Derived, typename ArgumentType>
+class TokenGrammar {
 public:
-    Parser();
+    struct OptionMatch {
+        const ArgumentType* argument {};
+        // The token abbreviates more options
+        bool ambiguous {};
+        // Value given in the token itself, as in '--name=value'
+        bool has_value {};
+        std::string_view value {};
+    };
+
+    // What the grammar makes of a token that starts an argument
+    struct TokenAction {
+        enum class Kind : std::uint8_t {
+            // '--': the following tokens are positional arguments
+            EndOptions,
+            // The token is the option argument (with its only parameter attached, if has_value)
+            Option,
+            // Many short options in a single token ('-abc'), or a short option with its value ('-z2.0')
+            ShortBundle,
+            // The token is (the first word of) command: the following tokens are its own
+            Command,
+            // The token is the first parameter of the positional argument
+            Positional,
+            // The token is not valid: error, possibly about argument
+            Error,
+        };
+
+        Kind kind {};
+        const ArgumentType* argument {};
+        const CommandNode* command {};
+        bool has_value {};
+        std::string_view value {};
+        ParseErrorCode error {};
+    };
+
+protected:
+    // Decides what the token starting an argument is, advancing the state of the grammar
+    // (the positional arguments read, the options terminator)
+    TokenAction next_action(std::string_view token, GrammarState& state) const;
+
+    // Whether token ends the parameters of a variadic argument (it starts another argument)
+    bool ends_params(std::string_view token, const GrammarState& state) const;
+
+    // Number of the next tokens that are parameters of arg
+    unsigned int count_params(const ArgumentType& arg, const ArgumentParseContext& context,
+                              const GrammarState& state) const;
+
+    // A value attached to the option's token ('--name=value', '-n1') is the only parameter of a variadic option,
+    // while an option taking a fixed number of parameters takes the following ones too
+    static void limit_attached(const ArgumentType& arg, ArgumentParseContext& context);
+
+private:
+    const Derived& derived() const {
+        return static_cast<const Derived&>(*this);
+    }
+};
+
+/*
+ * The outcome of a parse against a ParserSpec.
+ * Values are kept as views over the parsed tokens,
+ * which therefore must outlive the state.
+ */
+class ParseState {
+public:
+    friend class ParserSpec;
+    friend class Parser;
+    friend class IncrementalParser;
+
+    bool ok() const;
+    bool help_requested() const;
+    const ParseErrors& errors() const;
+
+    // Whether the given argument has been found by the last parse
+    bool was_set(const ArgumentConfig& arg) const;
+
+    // Path of the command found by the last parse (empty if none): the parse stops there,
+    // the tokens following it are the command's
+    std::string_view command() const;
+
+    // Converts the parameters found for the given argument into data.
+    // Returns false if the argument was not found or it's not valid.
+    template <typename T>
+    bool get(const ArgumentConfig& arg, T& data) const;
+
+private:
+    // Parameters of an occurrence of an argument
+    struct ParamsSpan {
+        unsigned int offset {};
+        unsigned int count {};
+        // Next occurrence of the same argument (NO_INDEX if it's the last one)
+        unsigned int next {NO_INDEX};
+    };
+
+    // Occurrences of an argument, in the order they are found (repeated options are converted one by one)
+    struct ParamsChain {
+        unsigned int first {};
+        unsigned int last {};
+    };
+
+    void reset(std::size_t num_arguments);
+    void mark_parsed(unsigned int index);
+    bool is_parsed(unsigned int index) const;
+
+    // Appends the parameters recorded from offset to the occurrences of the argument
+    void add_params_span(unsigned int index, unsigned int offset);
+
+    ParseErrors errors_ {};
+
+    // Bitmap indexed by the arguments' index
+    std::vector<std::uint64_t> parsed_args {};
+
+    // Parameters of the parsed arguments
+    std::vector<std::string_view> params {};
+    std::vector<ParamsSpan> params_spans {};
+    // Indexed by the arguments' index (valid only for the parsed ones)
+    std::vector<ParamsChain> params_chains {};
+
+    GrammarState grammar {};
+
+    const CommandNode* command_ {};
+
+    bool help_request {};
+};
+
+/*
+ * The arguments' specification.
+ * Once frozen, it's never modified by parse(): many threads
+ * can parse concurrently against the same spec, each one with its own ParseState.
+ */
+class ParserSpec : protected TokenGrammar<ParserSpec, Argument> {
+public:
+    friend class IncrementalParser;
+    friend class TokenGrammar<ParserSpec, Argument>;
+
+    ParserSpec();
 
     template <typename T, typename Name, typename... OtherNames>
     ArgumentConfig& add_argument(T& data, Name primary_name, OtherNames... alternative_names);
 
+    // Whether long options can be abbreviated with any unique prefix of theirs, e.g. '--scal' for '--scaling'
+    // (enabled by default)
+    ParserSpec& abbreviations(bool enable);
+
+    // Compiles the options into the flat lookup index (done automatically by Parser's first parse).
+    // Must be called again if an argument is modified (e.g. set as required) after the parser has been frozen.
+    // The rendered help is discarded too.
+    void freeze();
+
+    // Validates the tokens into state, without touching the bound targets.
+    // The spec must be frozen.
+    bool parse(unsigned int argc, const char* const* argv, ParseState& state, unsigned int from = 0) const;
+    bool parse(const std::string_view* tokens, unsigned int count, ParseState& state) const;
+
+    // The help is rendered only once for a given width (and cached until the spec changes)
+    void print_help(IOutputSink& out = standard_output(), unsigned int width = terminal_width()) const;
+    void print_usage(IOutputSink& out = standard_output(), unsigned int width = terminal_width()) const;
+
+    // Renders the message of an error reported by a parse against this spec
+    std::string format_error(const ParseError& error) const;
+
+protected:
+    ArgumentConfig& emplace_argument(std::vector<std::string>&& names, ArgumentTarget&& target);
+
+    // Finds (or adds) the node of the command at path in the trie (null if path is empty)
+    CommandNode* emplace_command(std::string_view path);
+
+    void parse(ArgumentParseContext& context, ParseState& state, bool bind) const;
+
+    // Lookups of the grammar (see TokenGrammar)
+    // Looks up the option named token (or abbreviated by it), with the value attached to it, if any
+    OptionMatch match_option(std::string_view token) const;
+    bool is_short_bundle(std::string_view token) const;
+    const CommandNode* find_command(std::string_view token) const;
+    const Argument* positional(unsigned int index) const;
+
+    // Building blocks of parse(), in order
+    bool begin_parse(ParseState& state) const;
+    void parse_argument(const Argument& arg, ArgumentParseContext& context, ParseState& state, bool bind) const;
+    void parse_option(const Argument& arg, ArgumentParseContext& context, ParseState& state, bool bind) const;
+    void parse_command(const CommandNode& command, ArgumentParseContext& context, ParseState& state) const;
+    // Whether token can name a command (an unknown one, if it follows a group of commands), rather than an option
+    static bool is_command_word(std::string_view token);
+    void parse_short_bundle(std::string_view token, ArgumentParseContext& context, ParseState& state,
+                            bool bind) const;
+    void end_parse(ParseState& state) const;
+
+    std::vector<HelpEntry> help_entries() const;
+    void print_help(IOutputSink& out, unsigned int width, bool usage_only) const;
+
+    // Arguments are stored by value, in contiguous chunks that never move
+    std::deque<Argument> arguments {};
+    std::vector<const Argument*> positionals {};
+    // Keys are views over the names owned by the arguments themselves
+    std::unordered_map<std::string_view, const Argument*> options {};
+    OptionIndex option_index {};
+    bool frozen {};
+    bool abbreviations_ {true};
+
+    // Bitmap indexed by the arguments' index
+    std::vector<std::uint64_t> required_args {};
+
+    std::vector<ParseError> setup_errors {};
+
+    // Trie of the commands (its root, if any, is the first node): nodes never move
+    std::deque<CommandNode> commands {};
+
+    // Heap allocated so that the spec stays movable
+    std::unique_ptr<HelpCache> help_cache {std::make_unique<HelpCache>()};
+};
+
+/*
+ * Parser that writes directly into the bound targets.
+ */
+class Parser : public ParserSpec {
+public:
+    friend class IncrementalParser;
+
+    using ParserSpec::parse;
+
     bool parse(unsigned int argc, char** argv, unsigned int from = 0);
+    bool parse(const std::string_view* tokens, unsigned int count);
+
+    // Expand the '@path' tokens with the content of the file at path (see ResponseFiles)
+    Parser& response_files(bool enable);
+
+    // Where the help and the errors are written (by default, the standard output and error)
+    Parser& help_output(IOutputSink& sink);
+    Parser& error_output(IOutputSink& sink);
+
+    // Width of the help (0, the default, for the terminal's width)
+    Parser& help_width(unsigned int width);
+
+    // Adds the command at path, its words separated by spaces (e.g. 'db migrate up').
+    // Its parser is set up by factory, which is called only if the command is found:
+    // the tokens following the command are parsed by its parser.
+    Parser& add_command(std::string_view path, std::string help, CommandFactory factory);
+
+    // Adds the command at path, implemented by the shared library at library_path (see Plugin):
+    // the library is loaded only if the command is found, or to describe it in the help if help is not given
+    Parser& add_plugin_command(std::string_view path, const std::string& library_path, std::string help = {});
+
+    // Whether the given argument has been found by the last parse
+    bool was_set(const ArgumentConfig& arg) const;
+
+    // Path of the command found by the last parse (empty if none)
+    std::string_view command() const;
+
+    // Parser of the command found by the last parse (null if none)
+    Parser* command_parser() const;
 
 private:
-    void print_help() const;
+    bool parse(ArgumentParseContext& context);
 
-    std::vector<std::unique_ptr<Argument>> arguments {};
-    std::vector<Argument*> positionals {};
-    std::unordered_map<std::string, Argument*> options {};
+    // Sets up the parser of the command found (and only that one)
+    Parser& setup_command(const CommandNode& command);
 
-    std::vector<std::string> setup_errors {};
-    std::vector<std::string> parse_errors {};
+    ParseState state {};
 
-    bool help_request {};
+    std::unique_ptr<Parser> command_parser_ {};
+
+    // Shared by their commands
+    std::vector<std::shared_ptr<Plugin>> plugins {};
+
+    bool response_files_ {};
+
+    IOutputSink* help_sink {&standard_output()};
+    IOutputSink* error_sink {&standard_error()};
+    unsigned int help_width_ {};
 };
 } // namespace Args
 
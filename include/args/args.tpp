@@ -1,100 +1,380 @@
 #ifndef ARGS_TPP
 #define ARGS_TPP
 
-#include <optional>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <limits>
 
 namespace Args {
 template <typename T>
-ArgumentImplT<T>::ArgumentImplT(T& data, std::vector<std::string>&& names) :
-    Argument {std::move(names)},
+ArgumentImplT<T>::ArgumentImplT(T& data) :
     data {data} {
 }
 
 template <typename T>
-ArgumentImpl<T>::ArgumentImpl(T& data, std::vector<std::string> names) :
-    ArgumentImplT<T> {data, std::move(names)} {
+ArgumentImpl<T>::ArgumentImpl(T& data) :
+    ArgumentImplT<T> {data} {
 }
 
 template <typename T>
-void ArgumentImpl<T>::parse(ArgumentParseContext& feed) {
+struct is_vector : std::false_type {};
+
+template <typename T, typename Allocator>
+struct is_vector<std::vector<T, Allocator>> : std::true_type {};
+
+template <typename T>
+struct is_array : std::false_type {};
+
+template <typename T, std::size_t N>
+struct is_array<std::array<T, N>> : std::true_type {};
+
+// Whether T is stored inline in ArgumentTarget
+template <typename T>
+constexpr bool is_builtin_argument_v = std::is_constructible_v<ArgumentTarget, std::in_place_type_t<T*>, T*>;
+
+// Whether T is a container of built-in types, bound through a ContainerTarget
+template <typename T>
+constexpr bool is_container_argument_v = [] {
+    if constexpr (is_vector<T>::value || is_array<T>::value) {
+        using Element = typename T::value_type;
+        return is_builtin_argument_v<Element> && !std::is_same_v<Element, bool>;
+    } else {
+        return false;
+    }
+}();
+
+template <typename T>
+constexpr unsigned int argument_num_params() {
+    if constexpr (std::is_same_v<T, bool>) {
+        return 0;
+    } else if constexpr (is_array<T>::value) {
+        return std::tuple_size_v<T>;
+    } else {
+        return 1;
+    }
+}
+
+template <typename T>
+constexpr unsigned int argument_max_params() {
+    if constexpr (is_vector<T>::value) {
+        return UNBOUNDED_PARAMS;
+    } else {
+        return argument_num_params<T>();
+    }
+}
+
+template <typename T>
+std::errc parse_number(std::string_view s, T& value) {
+    const char* first = s.data();
+    const char* const last = s.data() + s.size();
+
+    // std::from_chars does not accept an explicit plus sign
+    bool negative = false;
+    if (first != last && (*first == '+' || *first == '-')) {
+        negative = *first == '-';
+        first++;
+    }
+
+    if constexpr (std::is_integral_v<T>) {
+        // Optional base prefix: 0x (hex), 0o (octal), 0b (binary)
+        int base = 10;
+        if (last - first > 2 && first[0] == '0') {
+            switch (first[1]) {
+            case 'x':
+            case 'X':
+                base = 16;
+                break;
+            case 'o':
+            case 'O':
+                base = 8;
+                break;
+            case 'b':
+            case 'B':
+                base = 2;
+                break;
+            default:
+                break;
+            }
+            if (base != 10) {
+                first += 2;
+            }
+        }
+
+        // Parse the magnitude, then check it against the range of T
+        using U = std::make_unsigned_t<T>;
+        U magnitude {};
+        const auto [ptr, ec] = std::from_chars(first, last, magnitude, base);
+        if (ec != std::errc {}) {
+            return ec;
+        }
+        if (ptr != last) {
+            return std::errc::invalid_argument;
+        }
+
+        if constexpr (std::is_signed_v<T>) {
+            const U limit = static_cast<U>(std::numeric_limits<T>::max()) + (negative ? 1 : 0);
+            if (magnitude > limit) {
+                return std::errc::result_out_of_range;
+            }
+            value = static_cast<T>(negative ? U {0} - magnitude : magnitude);
+        } else {
+            if (negative && magnitude) {
+                return std::errc::result_out_of_range;
+            }
+            value = magnitude;
+        }
+    } else {
+        static_assert(std::is_floating_point_v<T>);
+
+        if (first != last && (*first == '+' || *first == '-')) {
+            // Double sign
+            return std::errc::invalid_argument;
+        }
+
+        T magnitude {};
+        const auto [ptr, ec] = std::from_chars(first, last, magnitude);
+        if (ec != std::errc {}) {
+            return ec;
+        }
+        if (ptr != last) {
+            return std::errc::invalid_argument;
+        }
+
+        value = negative ? -magnitude : magnitude;
+    }
+
+    return {};
+}
+
+template <typename T>
+void parse_argument(T& data, ArgumentParseContext& feed) {
     if constexpr (std::is_same_v<T, bool>) {
         // Boolean
-        this->data = true;
+        data = true;
     } else if constexpr (std::is_same_v<T, std::string>) {
         // String
-        this->data = feed.pop_next();
+        data = feed.pop_next();
     } else if constexpr (std::is_arithmetic_v<T>) {
         // Numbers
-        const std::string& next = feed.pop_next();
-        const char* cstr = next.c_str();
-
-        char* endptr {};
-        errno = 0;
+        const std::string_view next = feed.pop_next();
 
-        if constexpr (std::is_integral_v<T>) {
-            this->data = std::strtol(cstr, &endptr, 10);
-        } else {
-            static_assert(std::is_floating_point_v<T>);
-            this->data = std::strtof(cstr, &endptr);
+        if (const std::errc ec = parse_number(next, data); ec == std::errc::result_out_of_range) {
+            feed.add_error(ParseErrorCode::NumberOutOfRange);
+        } else if (ec != std::errc {}) {
+            feed.add_error(ParseErrorCode::InvalidNumber);
         }
-
-        if (errno || endptr == cstr) {
-            feed.add_error("failed to parse '" + next + "' as number");
+    } else if constexpr (is_vector<T>::value) {
+        // Append all the available tokens, reserving the space at once.
+        // The capacity grows geometrically, so that repeating the option ('-I a -I b') stays linear.
+        if (const std::size_t size = data.size() + feed.remaining(); data.capacity() < size) {
+            data.reserve(std::max(size, 2 * data.capacity()));
+        }
+        while (feed.has_next()) {
+            if constexpr (std::is_same_v<typename T::value_type, std::string>) {
+                data.emplace_back(feed.pop_next());
+            } else {
+                typename T::value_type value {};
+                parse_argument(value, feed);
+                data.push_back(value);
+            }
+        }
+    } else if constexpr (is_array<T>::value) {
+        for (auto& value : data) {
+            parse_argument(value, feed);
         }
     }
 }
 
+template <typename T>
+void ArgumentImpl<T>::parse(ArgumentParseContext& context) {
+    parse_argument(this->data, context);
+}
+
 template <typename T>
 unsigned int ArgumentImpl<T>::num_params() const {
-    if constexpr (std::is_same_v<T, bool>) {
-        return 0;
+    return argument_num_params<T>();
+}
+
+template <typename T>
+ArgumentTarget make_argument_target(T& data) {
+    if constexpr (is_builtin_argument_v<T>) {
+        // Built-in type
+        return ArgumentTarget {std::in_place_type<T*>, &data};
+    } else if constexpr (is_container_argument_v<T>) {
+        // Container of built-in types
+        ContainerTarget target {};
+        target.container = &data;
+        target.parse = [](void* container, ArgumentParseContext& context) {
+            parse_argument(*static_cast<T*>(container), context);
+        };
+        target.check = [](ArgumentParseContext& context) {
+            using Element = typename T::value_type;
+            while (context.has_next()) {
+                if constexpr (std::is_same_v<Element, std::string>) {
+                    context.pop_next();
+                } else {
+                    Element value {};
+                    parse_argument(value, context);
+                }
+            }
+        };
+        target.min_params = argument_num_params<T>();
+        target.max_params = argument_max_params<T>();
+        target.resizable = is_vector<T>::value;
+        return target;
     } else {
-        return 1;
+        // User defined type
+        return std::make_unique<ArgumentImpl<T>>(data);
     }
 }
 
 template <typename T, typename Name, typename... OtherNames>
-ArgumentConfig& Parser::add_argument(T& data, Name primary_name, OtherNames... alternative_names) {
-    // Build the names
-    std::vector<std::string> names {primary_name, alternative_names...};
+ArgumentConfig& ParserSpec::add_argument(T& data, Name primary_name, OtherNames... alternative_names) {
+    return emplace_argument({primary_name, alternative_names...}, make_argument_target(data));
+}
+
+template <typename Entries>
+void HelpCache::print(unsigned int w, bool usage_only, Entries&& entries, IOutputSink& out) {
+    std::lock_guard lock {mutex};
 
-    // Figure out if argument is positional or an option
-    std::optional<bool> is_option {};
-    for (const auto& name : names) {
-        if (name.empty()) {
-            setup_errors.emplace_back("empty argument name");
-            continue;
+    if (text.empty() || width != w) {
+        if (!layout) {
+            layout = layout_help(entries());
         }
+        text = render_help(*layout, w);
+        width = w;
+        // The usage line is followed by an empty line
+        const std::size_t usage_end = text.find("\n\n");
+        usage_size = usage_end != std::string::npos ? usage_end + 1 : text.size();
+    }
 
-        bool current_is_option = name[0] == '-';
+    out.write(text.data(), usage_only ? usage_size : text.size());
+}
 
-        if (!is_option) {
-            // First name
-            is_option = current_is_option;
+template <typename T>
+bool ParseState::get(const ArgumentConfig& arg, T& data) const {
+    if (!was_set(arg)) {
+        return false;
+    }
+
+    // Convert the recorded parameters of each occurrence as they were the only tokens,
+    // just like binding does (e.g. a repeated std::vector option appends)
+    ParseErrors conversion_errors {};
+    for (unsigned int i = params_chains[arg.index].first; i != NO_INDEX; i = params_spans[i].next) {
+        const ParamsSpan& span = params_spans[i];
+        ArgumentParseContext context {params.data() + span.offset, span.count, conversion_errors};
+
+        if constexpr (is_builtin_argument_v<T> || is_container_argument_v<T>) {
+            parse_argument(data, context);
         } else {
-            // Alternative names
-            if (*is_option != current_is_option) {
-                setup_errors.emplace_back("all argument's names must either be optional or positional");
-            }
+            ArgumentImpl<T> {data}.parse(context);
         }
     }
 
-    // Build the argument
-    arguments.push_back(std::make_unique<ArgumentImpl<T>>(data, names));
-    std::unique_ptr<Argument>& arg = arguments.back();
+    return conversion_errors.empty();
+}
+
+template <typename Derived, typename ArgumentType>
+typename TokenGrammar<Derived, ArgumentType>::TokenAction
+TokenGrammar<Derived, ArgumentType>::next_action(std::string_view token, GrammarState& state) const {
+    TokenAction action {};
 
-    if (*is_option) {
-        // Option
-        for (const auto& name : names) {
-            options.emplace(name, &*arg);
+    if (!state.options_ended) {
+        if (token == OPTIONS_TERMINATOR) {
+            // From now on every token is a positional argument
+            state.options_ended = true;
+            action.kind = TokenAction::Kind::EndOptions;
+            return action;
         }
-    } else {
-        // Positional argument
-        arg->required_ = true;
-        positionals.push_back(&*arg);
+
+        // Check whether it is an option
+        const OptionMatch match = derived().match_option(token);
+        if (match.argument) {
+            action.argument = match.argument;
+            if (match.has_value && !match.argument->max_params()) {
+                action.kind = TokenAction::Kind::Error;
+                action.error = ParseErrorCode::UnexpectedParameter;
+            } else {
+                action.kind = TokenAction::Kind::Option;
+                action.has_value = match.has_value;
+                action.value = match.value;
+            }
+            return action;
+        }
+        if (match.ambiguous) {
+            // It abbreviates more options
+            action.kind = TokenAction::Kind::Error;
+            action.error = ParseErrorCode::AmbiguousArgument;
+            return action;
+        }
+
+        if (derived().is_short_bundle(token)) {
+            action.kind = TokenAction::Kind::ShortBundle;
+            return action;
+        }
+
+        if ((action.command = derived().find_command(token))) {
+            action.kind = TokenAction::Kind::Command;
+            return action;
+        }
+    }
+
+    if ((action.argument = derived().positional(state.positional_index))) {
+        // It's a positional argument we still have to read
+        action.kind = TokenAction::Kind::Positional;
+        state.positional_index++;
+        return action;
+    }
+
+    // Neither a positional or a known option
+    action.kind = TokenAction::Kind::Error;
+    action.error = ParseErrorCode::UnknownArgument;
+    return action;
+}
+
+template <typename Derived, typename ArgumentType>
+bool TokenGrammar<Derived, ArgumentType>::ends_params(std::string_view token, const GrammarState& state) const {
+    if (state.options_ended) {
+        return false;
+    }
+    if (token == OPTIONS_TERMINATOR) {
+        return true;
+    }
+    const OptionMatch match = derived().match_option(token);
+    return match.argument || match.ambiguous || derived().is_short_bundle(token);
+}
+
+template <typename Derived, typename ArgumentType>
+unsigned int TokenGrammar<Derived, ArgumentType>::count_params(const ArgumentType& arg,
+                                                               const ArgumentParseContext& context,
+                                                               const GrammarState& state) const {
+    const unsigned int min = arg.min_params();
+    const unsigned int max = arg.max_params();
+
+    if (min == max) {
+        // Fixed number of parameters: they are taken as they are, even if they look like options
+        return context.has_next(min) ? min : 0;
     }
 
-    return *arg;
+    if (state.options_ended) {
+        // The tokens are handed over as they are, in a single span: no lookup at all
+        return std::min(max, context.remaining());
+    }
+
+    // Variable number of parameters: take the tokens up to the next option
+    unsigned int count = 0;
+    while (count < max && context.has_next(count + 1) && !ends_params(context.peek(count), state)) {
+        count++;
+    }
+    return count;
+}
+
+template <typename Derived, typename ArgumentType>
+void TokenGrammar<Derived, ArgumentType>::limit_attached(const ArgumentType& arg, ArgumentParseContext& context) {
+    if (arg.min_params() != arg.max_params()) {
+        context.set_limit(1);
+    }
 }
 } // namespace Args
 
@@ -0,0 +1,72 @@
+#ifndef ARGS_BATCH_H
+#define ARGS_BATCH_H
+
+#include "args.h"
+
+#include <functional>
+
+namespace Args {
+// A command line to parse, as a span of tokens
+struct CommandLine {
+    const std::string_view* tokens {};
+    unsigned int count {};
+};
+
+/*
+ * Outcome of a batch parse: which lines succeeded,
+ * plus the structured errors of the failed ones only.
+ * The errors' tokens are views over the parsed lines, which therefore must outlive the result.
+ */
+class BatchResult {
+public:
+    friend BatchResult parse_batch(const ParserSpec& spec, const CommandLine* lines, std::size_t count,
+                                   const std::function<void(std::size_t, const ParseState&)>& on_parsed,
+                                   unsigned int num_threads);
+
+    std::size_t size() const;
+    std::size_t num_failed() const;
+
+    bool ok(std::size_t line) const;
+
+    // Errors of the given line (empty if the line is ok): see ParserSpec::format_error()
+    std::vector<ParseError> errors(std::size_t line) const;
+
+    // Number of the errors of the given line that didn't fit its ParseErrors (see ParseErrors::dropped())
+    std::size_t dropped(std::size_t line) const;
+
+private:
+    struct LineError {
+        std::size_t line {};
+        ParseError error {};
+    };
+
+    struct LineDropped {
+        std::size_t line {};
+        std::size_t count {};
+    };
+
+    std::vector<std::uint8_t> ok_ {};
+
+    // Sorted by line
+    std::vector<LineError> errors_ {};
+    // Sorted by line, only the lines that dropped any error
+    std::vector<LineDropped> dropped_ {};
+    std::size_t num_failed_ {};
+
+    // Messages of the Custom errors, one deque per worker (elements of a deque never move)
+    std::vector<std::deque<std::string>> messages_ {};
+};
+
+/*
+ * Parses all the given lines against the (frozen) spec across a work stealing pool of threads.
+ * Each thread reuses its own ParseState, which is passed to on_parsed (if any) after every
+ * line is parsed: on_parsed is invoked concurrently and must retrieve the values it needs
+ * from the state before returning.
+ * If num_threads is 0, the hardware concurrency is used.
+ */
+BatchResult parse_batch(const ParserSpec& spec, const CommandLine* lines, std::size_t count,
+                        const std::function<void(std::size_t, const ParseState&)>& on_parsed = {},
+                        unsigned int num_threads = 0);
+} // namespace Args
+
+#endif // ARGS_BATCH_H
@@ -0,0 +1,88 @@
+#ifndef ARGS_INCREMENTAL_H
+#define ARGS_INCREMENTAL_H
+
+#include "args.h"
+
+namespace Args {
+/*
+ * Push style parser: tokens are fed one at a time (e.g. as they arrive from a socket)
+ * and are parsed into the targets bound to the given Parser as soon as an argument is complete.
+ * Fed tokens don't need to outlive the call: only the parameters of the argument
+ * being parsed are kept (in a buffer reused across arguments).
+ * Once a command is found (see Parser::add_command()), its parser is set up
+ * and the following tokens are fed to an IncrementalParser of its own (see command()).
+ */
+class IncrementalParser {
+public:
+    enum class FeedResult {
+        Pending,   // The token is part of an argument still incomplete
+        Parsed,    // The token completed an argument
+        Failed,    // The input is not valid (see state().errors() and Parser::format_error())
+    };
+
+    explicit IncrementalParser(Parser& parser);
+
+    FeedResult feed(std::string_view token);
+
+    template <typename Iterator>
+    FeedResult feed(Iterator begin, Iterator end);
+
+    // Ends the input: returns whether the whole input was valid
+    bool finish();
+
+    // Starts a new input
+    void reset();
+
+    const ParseState& state() const;
+
+    // Parser fed with the tokens of the command found (null if none)
+    IncrementalParser* command() const;
+
+private:
+    void begin_pending(const Argument& arg, std::string_view name, unsigned int token_index);
+    bool begin_short_bundle(std::string_view token, unsigned int token_index);
+    void add_param(std::string_view token, unsigned int token_index);
+    // A value attached to the option's token is the only parameter of a variadic option
+    void limit_attached();
+    FeedResult parse_pending();
+    FeedResult feed_command_word(std::string_view token, unsigned int token_index);
+    bool begin_command(const std::string_view* next, unsigned int token_index);
+
+    Parser& parser;
+    ParseState state_ {};
+
+    // Number of the tokens fed since the last reset
+    unsigned int num_fed {};
+
+    // Argument waiting for its parameters, if any
+    const Argument* pending {};
+    unsigned int pending_min_params {};
+    unsigned int pending_max_params {};
+    std::string pending_name {};
+    unsigned int pending_index {};
+    unsigned int pending_params_index {};
+
+    // Parameters of the pending argument: their contents are copied into
+    // a single buffer and the views are built only once the argument is complete
+    std::string pending_buffer {};
+    std::vector<std::size_t> pending_ends {};
+    std::vector<std::string_view> pending_params {};
+
+    // Group of commands whose words are being fed, and the index of its last word
+    const CommandNode* command_node {};
+    unsigned int command_index {};
+
+    std::unique_ptr<IncrementalParser> command_ {};
+};
+
+template <typename Iterator>
+IncrementalParser::FeedResult IncrementalParser::feed(Iterator begin, Iterator end) {
+    FeedResult result = FeedResult::Pending;
+    for (; begin != end && result != FeedResult::Failed; ++begin) {
+        result = feed(*begin);
+    }
+    return result;
+}
+} // namespace Args
+
+#endif // ARGS_INCREMENTAL_H
@@ -0,0 +1,61 @@
+#ifndef ARGS_PLUGIN_H
+#define ARGS_PLUGIN_H
+
+#include "args.h"
+
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace Args {
+/*
+ * Shared library implementing commands (see Parser::add_plugin_command()),
+ * loaded only the first time one of its commands is needed. It must export, with C linkage,
+ *
+ *     void args_setup_command(Args::Parser& parser, const char* path);
+ *
+ * which sets up the parser of the command at path, and optionally
+ *
+ *     const char* args_command_help(const char* path);
+ *
+ * which describes it in the help.
+ * Once loaded, the library is never unloaded: the parsers it sets up refer to its code.
+ */
+class Plugin {
+public:
+    static constexpr const char* SETUP_SYMBOL = "args_setup_command";
+    static constexpr const char* HELP_SYMBOL = "args_command_help";
+
+    explicit Plugin(std::string path);
+
+    Plugin(const Plugin&) = delete;
+    Plugin& operator=(const Plugin&) = delete;
+
+    // Loads the library, if not done yet. Returns false (see error()) if it can't be loaded.
+    bool load();
+
+    // Sets up the parser of the command at path
+    bool setup_command(Parser& parser, const std::string& command);
+
+    // Help of the command at path (empty if the library doesn't describe it)
+    std::string command_help(const std::string& command);
+
+    const std::string& path() const;
+    const std::string& error() const;
+
+private:
+    using SetupFunction = void (*)(Parser& parser, const char* path);
+    using HelpFunction = const char* (*)(const char* path);
+
+    std::mutex mutex {};
+    std::string path_ {};
+    std::string error_ {};
+    bool attempted {};
+
+    void* handle {};
+    SetupFunction setup {};
+    HelpFunction help {};
+};
+} // namespace Args
+
+#endif // ARGS_PLUGIN_H
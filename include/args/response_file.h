@@ -0,0 +1,47 @@
+#ifndef ARGS_RESPONSE_FILE_H
+#define ARGS_RESPONSE_FILE_H
+
+#include "tokenizer.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Args {
+/*
+ * Expands the '@path' tokens with the tokens read from the file at path (recursively).
+ * Files are memory mapped (privately) and split in place with split_in_place():
+ * tokens are views over the mapped memory, which is written only to remove quotes and escapes.
+ * The tokens are valid as long as this object is alive.
+ */
+class ResponseFiles {
+public:
+    static constexpr unsigned int MAX_DEPTH = 16;
+
+    ResponseFiles() = default;
+    ~ResponseFiles();
+
+    ResponseFiles(const ResponseFiles&) = delete;
+    ResponseFiles& operator=(const ResponseFiles&) = delete;
+
+    bool expand(unsigned int argc, const char* const* argv, std::vector<std::string>& errors,
+                unsigned int from = 0);
+
+    const std::vector<std::string_view>& tokens() const;
+
+private:
+    struct File {
+        char* data {};
+        std::size_t size {};
+        bool mapped {};
+    };
+
+    bool expand(std::string_view token, unsigned int depth, std::vector<std::string>& errors);
+    bool load(std::string_view path, unsigned int depth, std::vector<std::string>& errors);
+
+    std::vector<File> files {};
+    std::vector<std::string_view> tokens_ {};
+};
+} // namespace Args
+
+#endif // ARGS_RESPONSE_FILE_H
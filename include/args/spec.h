@@ -0,0 +1,574 @@
+#ifndef ARGS_SPEC_H
+#define ARGS_SPEC_H
+
+#include "args.h"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+
+namespace Args {
+enum class StaticSpecError {
+    None,
+    EmptyName,
+    MixedNames,
+    DuplicateName,
+    NoPerfectHash,
+};
+
+/*
+ * Compile time description of an argument of type T with N names.
+ * Built with static_argument<T>(names...) and configured
+ * with the same chainable setters of ArgumentConfig.
+ */
+template <typename T, std::size_t N>
+class StaticArgument {
+public:
+    using type = T;
+    static constexpr std::size_t num_names = N;
+
+    constexpr explicit StaticArgument(const std::array<std::string_view, N>& names) :
+        names {names} {
+    }
+
+    constexpr StaticArgument required(bool req) const {
+        StaticArgument copy {*this};
+        copy.required_ = req;
+        return copy;
+    }
+
+    constexpr StaticArgument help(std::string_view h) const {
+        StaticArgument copy {*this};
+        copy.help_ = h;
+        return copy;
+    }
+
+    std::array<std::string_view, N> names {};
+    std::string_view help_ {};
+    bool required_ {};
+};
+
+template <typename T, typename... Names>
+constexpr StaticArgument<T, sizeof...(Names)> static_argument(Names... names) {
+    return StaticArgument<T, sizeof...(Names)> {{std::string_view {names}...}};
+}
+
+/*
+ * Compile time parser specification.
+ * All the names are validated and indexed by a minimal perfect hash table (hash and displace)
+ * while compiling: a constexpr StaticSpec lives entirely in read only data.
+ * The help argument ('--help', '-h') is implicitly appended as the last argument.
+ */
+template <typename... Arguments>
+class StaticSpec {
+public:
+    using types = std::tuple<typename Arguments::type...>;
+
+    static constexpr std::size_t help_index = sizeof...(Arguments);
+    static constexpr std::size_t num_arguments = sizeof...(Arguments) + 1;
+    static constexpr std::size_t num_names = (Arguments::num_names + ... + 2);
+    static constexpr std::uint16_t npos = UINT16_MAX;
+
+    static_assert(num_names < npos, "too many argument names");
+
+    struct ArgumentInfo {
+        constexpr unsigned int min_params() const {
+            return min_params_;
+        }
+
+        constexpr unsigned int max_params() const {
+            return max_params_;
+        }
+
+        std::size_t first_name {};
+        std::size_t num_names {};
+        std::string_view help {};
+        unsigned int min_params_ {};
+        unsigned int max_params_ {};
+        bool required {};
+        bool is_option {};
+    };
+
+    constexpr explicit StaticSpec(const Arguments&... args) {
+        (add_argument<typename Arguments::type>(args.names.data(), Arguments::num_names, args.help_, args.required_),
+         ...);
+
+        constexpr std::array<std::string_view, 2> help_names {"--help", "-h"};
+        add_argument<bool>(help_names.data(), help_names.size(), "Display this help message and quit", false);
+
+        if (error == StaticSpecError::None && has_duplicate_name()) {
+            error = StaticSpecError::DuplicateName;
+        }
+
+        if (error == StaticSpecError::None) {
+            build_table();
+        }
+    }
+
+    // Returns the index of the option named `name`, or npos
+    constexpr std::uint16_t find(std::string_view name) const {
+        const std::uint32_t hash = hash_name(name, seed);
+        const std::uint16_t name_index = table[slot_of(hash, displacements[hash % num_buckets])];
+        if (name_index != npos && names[name_index] == name) {
+            return name_owners[name_index];
+        }
+        return npos;
+    }
+
+    StaticSpecError error {};
+
+    std::array<std::string_view, num_names> names {};
+    std::array<std::uint16_t, num_names> name_owners {};
+    std::array<ArgumentInfo, num_arguments> arguments {};
+    std::array<std::uint16_t, num_arguments> positionals {};
+    std::size_t num_positionals {};
+
+private:
+    // One slot for each name (only the options' ones are used), and a displacement for about every two
+    static constexpr std::size_t table_size = num_names;
+    static constexpr std::size_t num_buckets = (num_names + 1) / 2;
+    static constexpr std::uint32_t max_seed = 64;
+
+    // Slot of the name with the given hash, moved by the displacement of its bucket
+    static constexpr std::size_t slot_of(std::uint32_t hash, std::uint32_t displacement) {
+        const std::uint32_t f1 = remix(hash, 0x85ebca6bu) % table_size;
+        const std::uint32_t f2 = remix(hash, 0xc2b2ae35u) % table_size;
+        const std::uint32_t d0 = displacement / table_size;
+        const std::uint32_t d1 = displacement % table_size;
+        return (f1 + static_cast<std::uint64_t>(d0) * f2 + d1) % table_size;
+    }
+
+    // Another hash of the name, (statistically) independent of the bucket's one
+    static constexpr std::uint32_t remix(std::uint32_t hash, std::uint32_t k) {
+        hash ^= k;
+        hash *= 0x9e3779b1u;
+        hash ^= hash >> 16;
+        return hash;
+    }
+
+    template <typename T>
+    constexpr void add_argument(const std::string_view* arg_names, std::size_t count, std::string_view h, bool req) {
+        const std::size_t arg_index = argument_count++;
+
+        ArgumentInfo& info = arguments[arg_index];
+        info.first_name = name_count;
+        info.num_names = count;
+        info.help = h;
+        info.min_params_ = argument_num_params<T>();
+        info.max_params_ = argument_max_params<T>();
+        info.required = req;
+
+        for (std::size_t i = 0; i < count; i++) {
+            const std::string_view name = arg_names[i];
+            if (name.empty()) {
+                error = StaticSpecError::EmptyName;
+                continue;
+            }
+            const bool current_is_option = name[0] == '-';
+            if (i == 0) {
+                info.is_option = current_is_option;
+            } else if (info.is_option != current_is_option) {
+                error = StaticSpecError::MixedNames;
+            }
+
+            names[name_count] = name;
+            name_owners[name_count] = static_cast<std::uint16_t>(arg_index);
+            name_count++;
+        }
+
+        if (!info.is_option) {
+            // Positional argument
+            info.required = true;
+            positionals[num_positionals++] = static_cast<std::uint16_t>(arg_index);
+        }
+    }
+
+    // Whether two names are the same: only the names with the same hash are compared
+    constexpr bool has_duplicate_name() const {
+        std::array<std::uint32_t, num_names> hashes {};
+        std::array<std::size_t, num_names + 1> bucket_start {};
+        for (std::size_t i = 0; i < num_names; i++) {
+            hashes[i] = hash_name(names[i]);
+            bucket_start[hashes[i] % num_names + 1]++;
+        }
+        for (std::size_t b = 0; b < num_names; b++) {
+            bucket_start[b + 1] += bucket_start[b];
+        }
+        std::array<std::size_t, num_names> bucket_names {};
+        std::array<std::size_t, num_names> bucket_fill {};
+        for (std::size_t i = 0; i < num_names; i++) {
+            const std::size_t b = hashes[i] % num_names;
+            bucket_names[bucket_start[b] + bucket_fill[b]++] = i;
+        }
+
+        for (std::size_t b = 0; b < num_names; b++) {
+            for (std::size_t i = bucket_start[b]; i < bucket_start[b + 1]; i++) {
+                for (std::size_t j = i + 1; j < bucket_start[b + 1]; j++) {
+                    const std::size_t n1 = bucket_names[i];
+                    const std::size_t n2 = bucket_names[j];
+                    if (hashes[n1] == hashes[n2] && names[n1] == names[n2]) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    constexpr void build_table() {
+        // Hash and displace: the names are grouped in buckets, then, from the biggest bucket,
+        // each one is given the first displacement that moves all its names into free slots
+        for (std::uint32_t s = 0; s < max_seed; s++) {
+            if (try_build_table(s)) {
+                seed = s;
+                return;
+            }
+        }
+
+        error = StaticSpecError::NoPerfectHash;
+    }
+
+    constexpr bool try_build_table(std::uint32_t s) {
+        for (auto& slot : table) {
+            slot = npos;
+        }
+        for (auto& displacement : displacements) {
+            displacement = 0;
+        }
+
+        // Sort the options' names by bucket
+        std::array<std::uint32_t, num_names> hashes {};
+        std::array<std::size_t, num_buckets + 1> bucket_start {};
+        for (std::size_t i = 0; i < num_names; i++) {
+            // Positionals are not looked up by name
+            if (arguments[name_owners[i]].is_option) {
+                hashes[i] = hash_name(names[i], s);
+                bucket_start[hashes[i] % num_buckets + 1]++;
+            }
+        }
+        std::size_t max_bucket_size = 0;
+        for (std::size_t b = 0; b < num_buckets; b++) {
+            max_bucket_size = std::max(max_bucket_size, bucket_start[b + 1]);
+            bucket_start[b + 1] += bucket_start[b];
+        }
+        std::array<std::size_t, num_names> bucket_names {};
+        std::array<std::size_t, num_buckets> bucket_fill {};
+        for (std::size_t i = 0; i < num_names; i++) {
+            if (arguments[name_owners[i]].is_option) {
+                const std::size_t b = hashes[i] % num_buckets;
+                bucket_names[bucket_start[b] + bucket_fill[b]++] = i;
+            }
+        }
+
+        std::array<std::size_t, num_names> slots {};
+        for (std::size_t size = max_bucket_size; size > 0; size--) {
+            for (std::size_t b = 0; b < num_buckets; b++) {
+                if (bucket_start[b + 1] - bucket_start[b] != size) {
+                    continue;
+                }
+
+                bool placed = false;
+                for (std::uint64_t d = 0; d < static_cast<std::uint64_t>(table_size) * table_size && !placed; d++) {
+                    const auto displacement = static_cast<std::uint32_t>(d);
+                    placed = true;
+                    for (std::size_t k = 0; k < size && placed; k++) {
+                        slots[k] = slot_of(hashes[bucket_names[bucket_start[b] + k]], displacement);
+                        placed = table[slots[k]] == npos;
+                        for (std::size_t j = 0; j < k && placed; j++) {
+                            placed = slots[j] != slots[k];
+                        }
+                    }
+                    if (placed) {
+                        displacements[b] = displacement;
+                        for (std::size_t k = 0; k < size; k++) {
+                            table[slots[k]] = static_cast<std::uint16_t>(bucket_names[bucket_start[b] + k]);
+                        }
+                    }
+                }
+
+                if (!placed) {
+                    // Two names can't be told apart in this bucket: try another seed
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    std::array<std::uint16_t, table_size> table {};
+    std::array<std::uint32_t, num_buckets> displacements {};
+    std::uint32_t seed {};
+    std::size_t argument_count {};
+    std::size_t name_count {};
+};
+
+template <typename... Arguments>
+constexpr StaticSpec<Arguments...> make_spec(const Arguments&... args) {
+    return StaticSpec<Arguments...> {args...};
+}
+
+template <typename Types>
+class StaticBindings;
+
+template <typename... Ts>
+class StaticBindings<std::tuple<Ts...>> {
+public:
+    explicit StaticBindings(Ts&... data) :
+        data {data...} {
+    }
+
+protected:
+    std::tuple<Ts&...> data;
+};
+
+/*
+ * Parser for a constexpr StaticSpec.
+ * The constructor binds the targets, in the same order
+ * (and with the same types) of the spec's arguments.
+ * The tokens follow the grammar of Parser (see TokenGrammar), though the options are matched
+ * by their exact names only: there are no abbreviations, bundles of short options or commands.
+ *
+ *  static constexpr auto spec = make_spec(static_argument<std::string>("rom"),
+ *                                         static_argument<bool>("--serial", "-s"));
+ *  StaticParser<spec> parser {args.rom, args.serial};
+ */
+template <const auto& Spec>
+class StaticParser
+    : public StaticBindings<typename std::decay_t<decltype(Spec)>::types>,
+      private TokenGrammar<StaticParser<Spec>, typename std::decay_t<decltype(Spec)>::ArgumentInfo> {
+    using SpecType = std::decay_t<decltype(Spec)>;
+    using Types = typename SpecType::types;
+    using ArgumentInfo = typename SpecType::ArgumentInfo;
+    using Grammar = TokenGrammar<StaticParser, ArgumentInfo>;
+    using OptionMatch = typename Grammar::OptionMatch;
+    using TokenAction = typename Grammar::TokenAction;
+
+    friend Grammar;
+
+    static_assert(Spec.error != StaticSpecError::EmptyName, "empty argument name");
+    static_assert(Spec.error != StaticSpecError::MixedNames,
+                  "all argument's names must either be optional or positional");
+    static_assert(Spec.error != StaticSpecError::DuplicateName, "duplicate argument name");
+    static_assert(Spec.error != StaticSpecError::NoPerfectHash, "failed to build a perfect hash for the options");
+
+public:
+    using StaticBindings<Types>::StaticBindings;
+
+    bool parse(unsigned int argc, char** argv, unsigned int from = 0) {
+        const auto print_errors = [this](const ParseErrors& errors) {
+            std::string s {};
+            for (const auto& error : errors) {
+                const std::string_view name = error.argument_index < SpecType::num_arguments
+                                                  ? Spec.names[Spec.arguments[error.argument_index].first_name]
+                                                  : std::string_view {};
+                s += "ERROR: " + format_error(error, name) + "\n";
+            }
+            if (errors.dropped()) {
+                s += "ERROR: ... and " + std::to_string(errors.dropped()) + " more errors\n";
+            }
+            error_sink->write(s.data(), s.size());
+        };
+
+        // Clear any previous parse error
+        parse_errors.clear();
+
+        ArgumentParseContext context {argv, argc, parse_errors, from};
+
+        std::bitset<SpecType::num_arguments> parsed_args {};
+
+        GrammarState grammar {};
+
+        while (context.has_next() && parse_errors.empty()) {
+            const std::string_view token = context.seek_next();
+
+            switch (const TokenAction action = this->next_action(token, grammar); action.kind) {
+            case TokenAction::Kind::EndOptions:
+                context.pop_next();
+                break;
+            case TokenAction::Kind::Option: {
+                context.pop_next();
+                const auto& info = *action.argument;
+                if (action.has_value) {
+                    // '--name=value': the value is its first parameter (the only one, if it's variadic)
+                    context.attach(action.value);
+                    Grammar::limit_attached(info, context);
+                }
+                if (const unsigned int count = this->count_params(info, context, grammar);
+                    count >= info.min_params()) {
+                    context.set_limit(count);
+                    parse_argument_at(index_of(info), context);
+                    parsed_args.set(index_of(info));
+                } else {
+                    context.add_error(ParseErrorCode::MissingParameter, index_of(info));
+                }
+                context.reset_limit();
+                break;
+            }
+            case TokenAction::Kind::Positional: {
+                // The token is not consumed: it's the first parameter
+                const auto& info = *action.argument;
+                if (const unsigned int count = this->count_params(info, context, grammar);
+                    count >= info.min_params()) {
+                    context.set_limit(count);
+                    parse_argument_at(index_of(info), context);
+                    context.reset_limit();
+                    parsed_args.set(index_of(info));
+                } else {
+                    parse_errors.add({ParseErrorCode::MissingParameter, NO_INDEX, index_of(info)});
+                }
+                break;
+            }
+            case TokenAction::Kind::Error:
+                context.pop_next();
+                context.add_error(action.error, action.argument ? index_of(*action.argument) : NO_INDEX);
+                break;
+            case TokenAction::Kind::ShortBundle:
+            case TokenAction::Kind::Command:
+                // Never found by the lookups of a StaticSpec
+                context.pop_next();
+                context.add_error(ParseErrorCode::UnknownArgument);
+                break;
+            }
+        }
+
+        // Print the help if either '-h' or '--help' is given.
+        if (help_request) {
+            help_request = false;
+            print_help();
+            return false;
+        }
+
+        // Check if we are missing some (required) argument
+        for (std::size_t i = 0; i < SpecType::num_arguments; i++) {
+            if (Spec.arguments[i].required && !parsed_args[i]) {
+                parse_errors.add({ParseErrorCode::MissingRequiredArgument, NO_INDEX, static_cast<unsigned int>(i)});
+            }
+        }
+
+        // Eventually dump parse errors
+        if (!parse_errors.empty()) {
+            print_errors(parse_errors);
+            return false;
+        }
+
+        // Everything is ok
+        return true;
+    }
+
+    // Where the help and the errors are written (by default, the standard output and error)
+    StaticParser& help_output(IOutputSink& sink) {
+        help_sink = &sink;
+        return *this;
+    }
+
+    StaticParser& error_output(IOutputSink& sink) {
+        error_sink = &sink;
+        return *this;
+    }
+
+    // Width of the help (0, the default, for the terminal's width)
+    StaticParser& help_width(unsigned int width) {
+        help_width_ = width;
+        return *this;
+    }
+
+private:
+    using ArgumentParser = void (*)(StaticParser&, ArgumentParseContext&);
+
+    template <std::size_t I>
+    static void parse_argument_of(StaticParser& parser, ArgumentParseContext& context) {
+        using T = std::tuple_element_t<I, Types>;
+        if constexpr (is_builtin_argument_v<T> || is_container_argument_v<T>) {
+            parse_argument(std::get<I>(parser.data), context);
+        } else {
+            // User defined type (the specialization of ArgumentImpl is called directly, not virtually)
+            ArgumentImpl<T> {std::get<I>(parser.data)}.ArgumentImpl<T>::parse(context);
+        }
+    }
+
+    template <std::size_t... Is>
+    static constexpr std::array<ArgumentParser, sizeof...(Is)> make_argument_parsers(std::index_sequence<Is...>) {
+        return {&parse_argument_of<Is>...};
+    }
+
+    // Jump table from the argument index to its (non virtual) parse function
+    static constexpr std::array<ArgumentParser, SpecType::help_index> argument_parsers =
+        make_argument_parsers(std::make_index_sequence<SpecType::help_index> {});
+
+    static unsigned int index_of(const ArgumentInfo& info) {
+        return static_cast<unsigned int>(&info - Spec.arguments.data());
+    }
+
+    // Lookups of the grammar (see TokenGrammar)
+
+    // Looks up the option named token, with the value attached to it with '=', if any
+    static constexpr OptionMatch match_option(std::string_view token) {
+        if (const std::uint16_t index = Spec.find(token); index != SpecType::npos) {
+            return {&Spec.arguments[index]};
+        }
+        if (token.size() < 2 || token[0] != '-') {
+            return {};
+        }
+
+        if (const std::size_t eq = token.find('='); eq != std::string_view::npos) {
+            if (const std::uint16_t index = Spec.find(token.substr(0, eq)); index != SpecType::npos) {
+                return {&Spec.arguments[index], false, true, token.substr(eq + 1)};
+            }
+        }
+        return {};
+    }
+
+    static constexpr bool is_short_bundle(std::string_view) {
+        return false;
+    }
+
+    static constexpr const CommandNode* find_command(std::string_view) {
+        return nullptr;
+    }
+
+    static constexpr const ArgumentInfo* positional(unsigned int index) {
+        return index < Spec.num_positionals ? &Spec.arguments[Spec.positionals[index]] : nullptr;
+    }
+
+    void parse_argument_at(std::size_t index, ArgumentParseContext& context) {
+        if (index == SpecType::help_index) {
+            help_request = true;
+        } else {
+            argument_parsers[index](*this, context);
+        }
+    }
+
+    void print_help() const {
+        // The spec never changes: its help is rendered once for all the parsers
+        help_cache.print(
+            help_width_ ? help_width_ : terminal_width(), false,
+            [] {
+                std::vector<HelpEntry> entries {};
+                entries.reserve(SpecType::num_arguments);
+                for (const auto& arg : Spec.arguments) {
+                    const auto* first = Spec.names.data() + arg.first_name;
+                    entries.push_back(
+                        {{first, first + arg.num_names}, arg.help, arg.min_params(), arg.max_params(), arg.required});
+                }
+                return entries;
+            },
+            *help_sink);
+    }
+
+    static inline HelpCache help_cache {};
+
+    ParseErrors parse_errors {};
+
+    bool help_request {};
+
+    IOutputSink* help_sink {&standard_output()};
+    IOutputSink* error_sink {&standard_error()};
+    unsigned int help_width_ {};
+};
+} // namespace Args
+
+#endif // ARGS_SPEC_H
@@ -0,0 +1,43 @@
+#ifndef ARGS_TOKENIZER_H
+#define ARGS_TOKENIZER_H
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace Args {
+/*
+ * Splits a command line into tokens, with the quoting rules of a POSIX shell:
+ * tokens are separated by whitespaces; single quotes preserve everything,
+ * double quotes preserve everything but the escaped '"' and '\', while
+ * outside quotes a backslash escapes any character (and removes a newline).
+ *
+ * Tokens without quotes or escapes (found with SIMD, where available) are views
+ * over the command line itself, which therefore must outlive the tokens.
+ * The others are unquoted into a buffer owned by the tokenizer, valid until the next tokenize().
+ *
+ *  Tokenizer tokenizer;
+ *  if (tokenizer.tokenize(line))
+ *      parser.parse(tokenizer.tokens().data(), tokenizer.tokens().size());
+ */
+class Tokenizer {
+public:
+    // Returns false if a quote is not terminated
+    bool tokenize(std::string_view command_line);
+
+    const std::vector<std::string_view>& tokens() const;
+
+private:
+    std::vector<std::string_view> tokens_ {};
+
+    std::unique_ptr<char[]> buffer {};
+    std::size_t buffer_capacity {};
+};
+
+// Splits [begin, end) into tokens in place, with the same rules of Tokenizer.
+// The memory is written only to remove quotes and escapes.
+// Returns false if a quote is not terminated.
+bool split_in_place(char* begin, char* end, std::vector<std::string_view>& tokens);
+} // namespace Args
+
+#endif // ARGS_TOKENIZER_H
@@ -1,16 +1,117 @@
 #include "args/args.h"
+#include "args/plugin.h"
+#include "args/response_file.h"
 #include <algorithm>
-#include <complex>
-#include <iostream>
+#include <cstring>
 #include <optional>
-#include <set>
 
 namespace Args {
 
 namespace {
+    // The help argument is always the first one
+    constexpr unsigned int HELP_ARGUMENT_INDEX = 0;
+
+    void print_errors(const std::vector<std::string>& errors, IOutputSink& out) {
+        std::string s {};
+        for (const auto& error : errors) {
+            s += "ERROR: " + error + "\n";
+        }
+        out.write(s.data(), s.size());
+    }
+
+    void print_errors(const ParserSpec& spec, const ParseErrors& errors, IOutputSink& out) {
+        std::string s {};
+        for (const auto& error : errors) {
+            s += "ERROR: " + spec.format_error(error) + "\n";
+        }
+        if (errors.dropped()) {
+            s += "ERROR: ... and " + std::to_string(errors.dropped()) + " more errors\n";
+        }
+        out.write(s.data(), s.size());
+    }
+
+    unsigned int count_trailing_zeros(std::uint64_t x) {
+        unsigned int n = 0;
+        while (!(x & 1)) {
+            x >>= 1;
+            n++;
+        }
+        return n;
+    }
+
+    // Decodes the UTF-8 code point at s[i], advancing i past it (invalid bytes are taken one at a time)
+    std::uint32_t decode_utf8(std::string_view s, std::size_t& i) {
+        const auto byte = [&s](std::size_t k) {
+            return static_cast<unsigned char>(s[k]);
+        };
+
+        const unsigned char lead = byte(i);
+        std::size_t length = 1;
+        std::uint32_t cp = lead;
+        if (lead >= 0xF0 && lead < 0xF8) {
+            length = 4;
+            cp = lead & 0x07;
+        } else if (lead >= 0xE0) {
+            length = 3;
+            cp = lead & 0x0F;
+        } else if (lead >= 0xC0) {
+            length = 2;
+            cp = lead & 0x1F;
+        }
+
+        if (length == 1 || i + length > s.size()) {
+            i++;
+            return lead;
+        }
+
+        for (std::size_t k = 1; k < length; k++) {
+            if ((byte(i + k) & 0xC0) != 0x80) {
+                i++;
+                return lead;
+            }
+            cp = (cp << 6) | (byte(i + k) & 0x3F);
+        }
+
+        i += length;
+        return cp;
+    }
+
+    // Number of terminal columns taken by the code point
+    unsigned int display_width(std::uint32_t cp) {
+        // Combining marks and zero width characters
+        if ((cp >= 0x0300 && cp <= 0x036F) || (cp >= 0x1AB0 && cp <= 0x1AFF) || (cp >= 0x1DC0 && cp <= 0x1DFF) ||
+            (cp >= 0x200B && cp <= 0x200F) || (cp >= 0x20D0 && cp <= 0x20FF) || (cp >= 0xFE20 && cp <= 0xFE2F)) {
+            return 0;
+        }
+
+        // East Asian wide and fullwidth characters, emoji
+        if ((cp >= 0x1100 && cp <= 0x115F) || (cp >= 0x2E80 && cp <= 0xA4CF && cp != 0x303F) ||
+            (cp >= 0xAC00 && cp <= 0xD7A3) || (cp >= 0xF900 && cp <= 0xFAFF) || (cp >= 0xFE30 && cp <= 0xFE4F) ||
+            (cp >= 0xFF00 && cp <= 0xFF60) || (cp >= 0xFFE0 && cp <= 0xFFE6) || (cp >= 0x1F300 && cp <= 0x1F64F) ||
+            (cp >= 0x1F900 && cp <= 0x1F9FF) || (cp >= 0x20000 && cp <= 0x3FFFD)) {
+            return 2;
+        }
+
+        return 1;
+    }
+
+    unsigned int display_width(std::string_view s) {
+        unsigned int width = 0;
+        for (std::size_t i = 0; i < s.size();) {
+            width += display_width(decode_utf8(s, i));
+        }
+        return width;
+    }
+
+    bool is_space(char c) {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
     /*
-     * Breaks the given string after max_width so that it
+     * Appends s to out, breaking it after max_width so that it
      * will always begin from col_width for the consecutive rows.
+     * row_width is the width of the row of out that s continues.
+     * Widths are display widths, in a single pass over s.
      *
      *  <-----max_width------>
      *  <-col_width->
@@ -18,72 +119,237 @@ namespace {
      *  |           |-------|
      *  |           |-------|
      */
-    std::string wrap(const std::string& s, unsigned int col_width, unsigned int max_width) {
-        static const char* whitespaces = " \f\n\r\t\v";
-
-        std::string out {};
-        std::string row {};
-        std::size_t begin {}, end {};
-
-        // Add inital white spaces
-        begin = s.find_first_not_of(whitespaces);
-        if (begin == std::string::npos) {
+    void wrap(std::string& out, std::string_view s, unsigned int col_width, unsigned int max_width,
+              unsigned int row_width = 0) {
+        // Add initial white spaces
+        std::size_t i = 0;
+        while (i < s.size() && is_space(s[i])) {
+            i++;
+        }
+        if (i == s.size()) {
             // There's nothing useful in the string
-            return {};
-        }
-        out += s.substr(0, begin);
-
-        do {
-            // Identify the next token
-            const auto first_space_after_token = s.find_first_of(whitespaces, begin);
-            end = s.find_first_not_of(whitespaces, first_space_after_token < std::string::npos
-                                                       ? first_space_after_token + 1
-                                                       : std::string::npos);
-            const std::string token = s.substr(begin, end - begin);
-            const auto token_size =
-                first_space_after_token < std::string::npos ? (first_space_after_token - begin) : s.size() - begin;
-            begin = end;
-
-            // Append it to the current row, if it fits
-            if (row.size() + token_size < max_width) {
-                // The token fits this row
-                row += token;
-            } else {
-                // The token does not fit this row: append the current row to
-                // the output and proceed by appending this token to the next row
-                out += row + "\n";
-                row = std::string(col_width, ' ') + token;
+            return;
+        }
+        out.append(s.data(), i);
+
+        while (i < s.size()) {
+            // Identify the next token, along with the white spaces that follow it
+            const std::size_t begin = i;
+            unsigned int token_width = 0;
+            while (i < s.size() && !is_space(s[i])) {
+                token_width += display_width(decode_utf8(s, i));
+            }
+            unsigned int spaces_width = 0;
+            for (; i < s.size() && is_space(s[i]); i++) {
+                spaces_width++;
             }
-        } while (end != std::string::npos);
 
-        // Eventually add the remaining part of the last row
-        out += row;
+            if (row_width + token_width >= max_width) {
+                // The token does not fit this row: proceed by appending it to the next row
+                out += '\n';
+                out.append(col_width, ' ');
+                row_width = col_width;
+            }
 
-        return out;
+            out.append(s.data() + begin, i - begin);
+            row_width += token_width + spaces_width;
+        }
     }
 } // namespace
 
-ArgumentParseContext::ArgumentParseContext(const std::vector<std::string>& argv, std::vector<std::string>& errors,
+std::string format_error(const ParseError& error, std::string_view argument_name) {
+    const std::string token {error.token.empty() ? argument_name : error.token};
+
+    switch (error.code) {
+    case ParseErrorCode::EmptyName:
+        return "empty argument name";
+    case ParseErrorCode::MixedNames:
+        return "all argument's names must either be optional or positional";
+    case ParseErrorCode::InvalidNargs:
+        return "invalid number of parameters for argument '" + std::string {argument_name} + "'";
+    case ParseErrorCode::NotFrozen:
+        return "parser spec is not frozen";
+    case ParseErrorCode::UnknownArgument:
+        return "unknown argument '" + token + "'";
+    case ParseErrorCode::AmbiguousArgument:
+        return "ambiguous argument '" + token + "'";
+    case ParseErrorCode::MissingParameter:
+        return "missing parameter for argument '" + token + "'";
+    case ParseErrorCode::UnexpectedParameter:
+        return "unexpected parameter for argument '" + token + "'";
+    case ParseErrorCode::MissingRequiredArgument:
+        return "missing required argument '" + std::string {argument_name} + "'";
+    case ParseErrorCode::InvalidNumber:
+        return "failed to parse '" + token + "' as number";
+    case ParseErrorCode::NumberOutOfRange:
+        return "number '" + token + "' is out of range";
+    case ParseErrorCode::UnknownCommand:
+        return "unknown command '" + token + "'";
+    case ParseErrorCode::MissingCommand:
+        return "missing command after '" + token + "'";
+    case ParseErrorCode::Custom:
+        return std::string {error.message};
+    }
+
+    return {};
+}
+
+void ParseErrors::add(const ParseError& error) {
+    if (size_ < CAPACITY) {
+        errors[size_++] = error;
+    } else {
+        dropped_++;
+    }
+}
+
+void ParseErrors::add(ParseError error, std::string&& message) {
+    if (size_ < CAPACITY) {
+        error.message = owned_strings().emplace_back(std::move(message));
+        errors[size_++] = error;
+    } else {
+        dropped_++;
+    }
+}
+
+void ParseErrors::clear() {
+    size_ = 0;
+    dropped_ = 0;
+    if (storage) {
+        storage->clear();
+    }
+}
+
+void ParseErrors::persist() {
+    for (std::size_t i = 0; i < size_; i++) {
+        if (!errors[i].token.empty()) {
+            errors[i].token = owned_strings().emplace_back(errors[i].token);
+        }
+    }
+}
+
+bool ParseErrors::empty() const {
+    return !size_ && !dropped_;
+}
+
+std::size_t ParseErrors::size() const {
+    return size_;
+}
+
+std::size_t ParseErrors::dropped() const {
+    return dropped_;
+}
+
+const ParseError& ParseErrors::operator[](std::size_t i) const {
+    return errors[i];
+}
+
+const ParseError* ParseErrors::begin() const {
+    return errors.data();
+}
+
+const ParseError* ParseErrors::end() const {
+    return errors.data() + size_;
+}
+
+std::deque<std::string>& ParseErrors::owned_strings() {
+    if (!storage) {
+        storage = std::make_unique<std::deque<std::string>>();
+    }
+    return *storage;
+}
+
+ArgumentParseContext::ArgumentParseContext(const char* const* argv, unsigned int argc, ParseErrors& errors,
                                            unsigned int index) :
     argv {argv},
+    argc {argc},
+    errors {errors},
+    index {index},
+    end {argc} {
+}
+
+ArgumentParseContext::ArgumentParseContext(const std::string_view* tokens, unsigned int count, ParseErrors& errors,
+                                           unsigned int index) :
+    tokens {tokens},
+    argc {count},
     errors {errors},
-    index {index} {
+    index {index},
+    end {count} {
 }
 
 bool ArgumentParseContext::has_next(unsigned int n) const {
-    return index + n <= argv.size();
+    return index + n <= end + has_attached;
+}
+
+std::string_view ArgumentParseContext::seek_next() const {
+    return peek(0);
+}
+
+std::string_view ArgumentParseContext::pop_next() {
+    std::string_view token {};
+    if (has_attached) {
+        // It belongs to the last popped token: that's the one errors refer to
+        token = attached;
+        has_attached = false;
+    } else {
+        token = tokens ? tokens[index] : argv[index];
+        last_index = token_offset + index;
+        index++;
+    }
+    last = token;
+    if (params) {
+        params->push_back(token);
+    }
+    return token;
+}
+
+std::string_view ArgumentParseContext::peek(unsigned int offset) const {
+    if (has_attached) {
+        if (!offset) {
+            return attached;
+        }
+        offset--;
+    }
+    return tokens ? tokens[index + offset] : argv[index + offset];
+}
+
+unsigned int ArgumentParseContext::remaining() const {
+    return end - index + has_attached;
+}
+
+void ArgumentParseContext::set_limit(unsigned int count) {
+    end = index + count - has_attached;
 }
 
-const std::string& ArgumentParseContext::seek_next() const {
-    return argv[index];
+void ArgumentParseContext::attach(std::string_view value) {
+    attached = value;
+    has_attached = true;
 }
 
-const std::string& ArgumentParseContext::pop_next() {
-    return argv[index++];
+void ArgumentParseContext::reset_limit() {
+    end = argc;
+}
+
+void ArgumentParseContext::record_params(std::vector<std::string_view>* p) {
+    params = p;
+}
+
+void ArgumentParseContext::set_token_offset(unsigned int offset) {
+    token_offset = offset;
+}
+
+ArgumentParseContext ArgumentParseContext::rest(ParseErrors& errors) const {
+    ArgumentParseContext context = tokens ? ArgumentParseContext {tokens, argc, errors, index}
+                                          : ArgumentParseContext {argv, argc, errors, index};
+    context.token_offset = token_offset;
+    return context;
+}
+
+void ArgumentParseContext::add_error(ParseErrorCode code, unsigned int argument) const {
+    errors.add({code, last_index, argument, last});
 }
 
 void ArgumentParseContext::add_error(std::string&& error) const {
-    errors.emplace_back(std::move(error));
+    errors.add({ParseErrorCode::Custom, last_index, NO_INDEX, last}, std::move(error));
 }
 
 ArgumentConfig::ArgumentConfig(std::vector<std::string>&& names) :
@@ -100,178 +366,886 @@ ArgumentConfig& ArgumentConfig::help(const std::string& h) {
     return *this;
 }
 
-Argument::Argument(std::vector<std::string>&& names) :
-    ArgumentConfig {std::move(names)} {
+ArgumentConfig& ArgumentConfig::nargs(char n) {
+    switch (n) {
+    case '?':
+        min_params_ = 0;
+        max_params_ = 1;
+        break;
+    case '*':
+        min_params_ = 0;
+        max_params_ = UNBOUNDED_PARAMS;
+        break;
+    case '+':
+        min_params_ = 1;
+        max_params_ = UNBOUNDED_PARAMS;
+        break;
+    default:
+        invalid_nargs_ = true;
+        return *this;
+    }
+
+    nargs_ = true;
+    invalid_nargs_ = false;
+
+    // A positional argument that can be empty is not required
+    if (!min_params_ && !names.empty() && !names[0].empty() && names[0][0] != '-') {
+        required_ = false;
+    }
+
+    return *this;
+}
+
+ArgumentConfig& ArgumentConfig::nargs(int n) {
+    if (n < 0) {
+        invalid_nargs_ = true;
+        return *this;
+    }
+    return nargs(static_cast<unsigned int>(n));
 }
 
-Parser::Parser() {
-    // Add the help argument by default
-    add_argument(help_request, "--help", "-h").help("Display this help message and quit");
+ArgumentConfig& ArgumentConfig::nargs(unsigned int n) {
+    min_params_ = max_params_ = n;
+    nargs_ = true;
+    invalid_nargs_ = false;
+    return *this;
 }
 
-bool Parser::parse(unsigned int argc, char** argv, unsigned int from) {
-    const auto print_errors = [](const std::vector<std::string>& errors) {
-        for (const auto& error : errors) {
-            std::cerr << "ERROR: " << error << std::endl;
+Argument::Argument(std::vector<std::string>&& names, ArgumentTarget&& target) :
+    ArgumentConfig {std::move(names)},
+    target {std::move(target)} {
+}
+
+void Argument::parse(ArgumentParseContext& context) const {
+    std::visit(
+        [&context](const auto& data) {
+            using Data = std::decay_t<decltype(data)>;
+            if constexpr (std::is_same_v<Data, std::unique_ptr<IParsableArgument>>) {
+                data->parse(context);
+            } else if constexpr (std::is_same_v<Data, ContainerTarget>) {
+                data.parse(data.container, context);
+            } else if constexpr (!std::is_same_v<Data, std::monostate>) {
+                parse_argument(*data, context);
+            }
+        },
+        target);
+}
+
+void Argument::check(ArgumentParseContext& context) const {
+    std::visit(
+        [&context](const auto& data) {
+            using Data = std::decay_t<decltype(data)>;
+            if constexpr (std::is_same_v<Data, std::unique_ptr<IParsableArgument>>) {
+                // User defined types can't be converted without their target:
+                // they are validated only when bound (or retrieved)
+                for (unsigned int i = 0; i < data->num_params(); i++) {
+                    context.pop_next();
+                }
+            } else if constexpr (std::is_same_v<Data, ContainerTarget>) {
+                data.check(context);
+            } else if constexpr (std::is_same_v<Data, std::string*>) {
+                context.pop_next();
+            } else if constexpr (!std::is_same_v<Data, std::monostate>) {
+                std::remove_pointer_t<Data> value {};
+                parse_argument(value, context);
+            }
+        },
+        target);
+}
+
+unsigned int Argument::min_params() const {
+    return std::visit(
+        [this](const auto& data) {
+            using Data = std::decay_t<decltype(data)>;
+            if constexpr (std::is_same_v<Data, std::unique_ptr<IParsableArgument>>) {
+                return data->num_params();
+            } else if constexpr (std::is_same_v<Data, ContainerTarget>) {
+                return data.resizable && nargs_ ? min_params_ : data.min_params;
+            } else if constexpr (std::is_same_v<Data, std::monostate>) {
+                return 0U;
+            } else {
+                return argument_num_params<std::remove_pointer_t<Data>>();
+            }
+        },
+        target);
+}
+
+unsigned int Argument::max_params() const {
+    return std::visit(
+        [this](const auto& data) {
+            using Data = std::decay_t<decltype(data)>;
+            if constexpr (std::is_same_v<Data, std::unique_ptr<IParsableArgument>>) {
+                return data->num_params();
+            } else if constexpr (std::is_same_v<Data, ContainerTarget>) {
+                return data.resizable && nargs_ ? max_params_ : data.max_params;
+            } else if constexpr (std::is_same_v<Data, std::monostate>) {
+                return 0U;
+            } else {
+                return argument_max_params<std::remove_pointer_t<Data>>();
+            }
+        },
+        target);
+}
+
+void OptionIndex::build(const std::unordered_map<std::string_view, const Argument*>& options) {
+    // Keep the load factor below 0.5 so that probe sequences stay short
+    std::size_t capacity = 1;
+    while (capacity < 2 * options.size()) {
+        capacity <<= 1;
+    }
+
+    slots.assign(capacity, {});
+    mask = capacity - 1;
+
+    for (const auto& [name, arg] : options) {
+        const std::uint32_t hash = hash_name(name);
+        std::size_t i = hash & mask;
+        while (slots[i].argument) {
+            i = (i + 1) & mask;
         }
-    };
+        slots[i] = {name, arg, hash};
+    }
 
-    // Quit immediately if the parser is not properly setup
-    if (!setup_errors.empty()) {
-        print_errors(setup_errors);
-        return false;
+    long_names.clear();
+    short_names.fill(nullptr);
+    for (const auto& [name, arg] : options) {
+        if (name.size() > 2 && name[0] == '-' && name[1] == '-') {
+            long_names.emplace_back(name, arg);
+        } else if (name.size() == 2 && name[0] == '-' && name[1] != '-') {
+            short_names[static_cast<unsigned char>(name[1])] = arg;
+        }
+    }
+    std::sort(long_names.begin(), long_names.end());
+}
+
+const Argument* OptionIndex::find(std::string_view name) const {
+    if (slots.empty()) {
+        return nullptr;
+    }
+
+    const std::uint32_t hash = hash_name(name);
+    for (std::size_t i = hash & mask; slots[i].argument; i = (i + 1) & mask) {
+        if (slots[i].hash == hash && slots[i].name == name) {
+            return slots[i].argument;
+        }
     }
 
-    // Build the args vector
-    std::vector<std::string> args {};
-    for (unsigned int i = from; i < argc; ++i) {
-        args.emplace_back(argv[i]);
+    return nullptr;
+}
+
+const Argument* OptionIndex::find_short(char c) const {
+    return short_names[static_cast<unsigned char>(c)];
+}
+
+const Argument* OptionIndex::find_prefix(std::string_view prefix, bool& ambiguous) const {
+    // The names starting with prefix are contiguous, from the first one not less than prefix
+    auto it = std::lower_bound(long_names.begin(), long_names.end(), prefix,
+                               [](const std::pair<std::string_view, const Argument*>& entry, std::string_view p) {
+                                   return entry.first < p;
+                               });
+
+    const Argument* found = nullptr;
+    for (; it != long_names.end() && it->first.substr(0, prefix.size()) == prefix; ++it) {
+        if (found && found != it->second) {
+            // Another argument (not just an alternative name of the same one)
+            ambiguous = true;
+            return nullptr;
+        }
+        found = it->second;
     }
 
-    // Clear any previous parse error
-    parse_errors.clear();
+    return found;
+}
+
+bool ParseState::ok() const {
+    return errors_.empty() && !help_request;
+}
+
+bool ParseState::help_requested() const {
+    return help_request;
+}
+
+const ParseErrors& ParseState::errors() const {
+    return errors_;
+}
+
+bool ParseState::was_set(const ArgumentConfig& arg) const {
+    return is_parsed(arg.index);
+}
 
-    // Actually start parse
-    ArgumentParseContext context {args, parse_errors};
+std::string_view ParseState::command() const {
+    return command_ ? std::string_view {command_->path} : std::string_view {};
+}
+
+void ParseState::reset(std::size_t num_arguments) {
+    // Reuse the buffers: no allocation after the first parse
+    errors_.clear();
+    parsed_args.assign((num_arguments + 63) / 64, 0);
+    params.clear();
+    params_spans.clear();
+    params_chains.resize(num_arguments);
+    grammar = {};
+    command_ = nullptr;
+    help_request = false;
+}
 
-    std::set<Argument*> parsed_args {};
+const CommandNode* CommandNode::find(std::string_view child_name) const {
+    const auto it = std::lower_bound(children.begin(), children.end(), child_name, [](const auto& child, auto name) {
+        return child.first < name;
+    });
+    return it != children.end() && it->first == child_name ? it->second : nullptr;
+}
 
-    unsigned int positional_index = 0;
+void ParseState::mark_parsed(unsigned int index) {
+    parsed_args[index / 64] |= std::uint64_t {1} << (index % 64);
+}
 
-    while (context.has_next() && parse_errors.empty()) {
-        // Pop next token
-        const auto& token = context.seek_next();
+bool ParseState::is_parsed(unsigned int index) const {
+    return index / 64 < parsed_args.size() && (parsed_args[index / 64] >> (index % 64)) & 1;
+}
 
-        // Check whether it is an option
-        if (const auto it = options.find(token); it != options.end()) {
-            // It's a known option
-            auto* const arg = it->second;
+void ParseState::add_params_span(unsigned int index, unsigned int offset) {
+    const auto span = static_cast<unsigned int>(params_spans.size());
+    params_spans.push_back({offset, static_cast<unsigned int>(params.size()) - offset});
 
-            // Consume the token
-            context.pop_next();
+    ParamsChain& chain = params_chains[index];
+    if (is_parsed(index)) {
+        // A repeated argument
+        params_spans[chain.last].next = span;
+        chain.last = span;
+    } else {
+        chain = {span, span};
+    }
+}
+
+ParserSpec::ParserSpec() {
+    // Add the help argument by default (it has no target: it's handled by the parse state)
+    emplace_argument({"--help", "-h"}, std::monostate {}).help("Display this help message and quit");
+}
+
+ArgumentConfig& ParserSpec::emplace_argument(std::vector<std::string>&& names, ArgumentTarget&& target) {
+    // Figure out if argument is positional or an option
+    std::optional<bool> is_option {};
+    for (const auto& name : names) {
+        if (name.empty()) {
+            setup_errors.push_back({ParseErrorCode::EmptyName, NO_INDEX, static_cast<unsigned int>(arguments.size())});
+            continue;
+        }
+
+        bool current_is_option = name[0] == '-';
+
+        if (!is_option) {
+            // First name
+            is_option = current_is_option;
+        } else {
+            // Alternative names
+            if (*is_option != current_is_option) {
+                setup_errors.push_back(
+                    {ParseErrorCode::MixedNames, NO_INDEX, static_cast<unsigned int>(arguments.size())});
+            }
+        }
+    }
+
+    // The lookup index (and the help) has to be rebuilt
+    frozen = false;
+    help_cache->clear();
+
+    // Build the argument
+    Argument& arg = arguments.emplace_back(std::move(names), std::move(target));
+    arg.index = arguments.size() - 1;
+
+    if (is_option.value_or(false)) {
+        // Option
+        for (const auto& name : arg.names) {
+            options.emplace(name, &arg);
+        }
+    } else {
+        // Positional argument
+        arg.required_ = true;
+        positionals.push_back(&arg);
+    }
+
+    return arg;
+}
+
+CommandNode* ParserSpec::emplace_command(std::string_view path) {
+    if (commands.empty()) {
+        // The root of the trie
+        commands.emplace_back();
+    }
+
+    // Find (or add) the node of each word of the path
+    CommandNode* node = &commands.front();
+    for (std::size_t begin = path.find_first_not_of(' '); begin != std::string_view::npos;) {
+        const std::size_t end = path.find(' ', begin);
+        const std::string_view name = path.substr(begin, end - begin);
+
+        auto it = std::lower_bound(node->children.begin(), node->children.end(), name,
+                                   [](const auto& child, auto child_name) {
+                                       return child.first < child_name;
+                                   });
+        if (it == node->children.end() || it->first != name) {
+            CommandNode& child = commands.emplace_back();
+            child.name = name;
+            child.path = node->path.empty() ? std::string {name} : node->path + ' ' + child.name;
+            it = node->children.insert(it, {child.name, &child});
+        }
+        node = it->second;
+
+        begin = end == std::string_view::npos ? end : path.find_first_not_of(' ', end);
+    }
 
-            // Verify that there are enough tokens for this argument
-            if (context.has_next(arg->num_params())) {
-                arg->parse(context);
-                parsed_args.emplace(arg);
+    if (node == &commands.front()) {
+        setup_errors.push_back({ParseErrorCode::EmptyName});
+        return nullptr;
+    }
+
+    // The commands are listed in the help
+    help_cache->clear();
+
+    return node;
+}
+
+ParserSpec& ParserSpec::abbreviations(bool enable) {
+    abbreviations_ = enable;
+    return *this;
+}
+
+void ParserSpec::freeze() {
+    option_index.build(options);
+
+    // The arguments can be configured until now: check them again
+    setup_errors.erase(std::remove_if(setup_errors.begin(), setup_errors.end(),
+                                      [](const ParseError& error) {
+                                          return error.code == ParseErrorCode::InvalidNargs;
+                                      }),
+                       setup_errors.end());
+    for (const auto& arg : arguments) {
+        if (arg.invalid_nargs_) {
+            setup_errors.push_back({ParseErrorCode::InvalidNargs, NO_INDEX, arg.index});
+        }
+    }
+
+    // Precompute the bitmap of the required arguments
+    required_args.assign((arguments.size() + 63) / 64, 0);
+    for (const auto& arg : arguments) {
+        if (arg.required_) {
+            required_args[arg.index / 64] |= std::uint64_t {1} << (arg.index % 64);
+        }
+    }
+
+    help_cache->clear();
+
+    frozen = true;
+}
+
+bool ParserSpec::parse(unsigned int argc, const char* const* argv, ParseState& state, unsigned int from) const {
+    ArgumentParseContext context {argv, argc, state.errors_, from};
+    parse(context, state, false);
+    return state.ok();
+}
+
+bool ParserSpec::parse(const std::string_view* tokens, unsigned int count, ParseState& state) const {
+    ArgumentParseContext context {tokens, count, state.errors_};
+    parse(context, state, false);
+    return state.ok();
+}
+
+void ParserSpec::parse(ArgumentParseContext& context, ParseState& state, bool bind) const {
+    if (!begin_parse(state)) {
+        return;
+    }
+
+    while (context.has_next() && state.errors_.empty() && !state.command_) {
+        const std::string_view token = context.seek_next();
+
+        switch (const TokenAction action = next_action(token, state.grammar); action.kind) {
+        case TokenAction::Kind::EndOptions:
+            context.pop_next();
+            break;
+        case TokenAction::Kind::Option:
+            context.pop_next();
+            if (action.has_value) {
+                // '--name=value': the value is its first parameter (the only one, if it's variadic)
+                context.attach(action.value);
+                limit_attached(*action.argument, context);
+            }
+            parse_option(*action.argument, context, state, bind);
+            context.reset_limit();
+            break;
+        case TokenAction::Kind::ShortBundle:
+            context.pop_next();
+            parse_short_bundle(token, context, state, bind);
+            break;
+        case TokenAction::Kind::Command:
+            context.pop_next();
+            parse_command(*action.command, context, state);
+            break;
+        case TokenAction::Kind::Positional: {
+            // The token is not consumed: it's the first parameter
+            const auto& arg = *action.argument;
+            if (const unsigned int count = count_params(arg, context, state.grammar); count >= arg.min_params()) {
+                context.set_limit(count);
+                parse_argument(arg, context, state, bind);
+                context.reset_limit();
             } else {
-                context.add_error("missing parameter for argument '" + token + "'");
+                state.errors_.add({ParseErrorCode::MissingParameter, NO_INDEX, arg.index});
             }
-        } else if (positional_index < positionals.size()) {
-            // It's a positional argument we still have to read
-            auto* const arg = positionals[positional_index++];
-            arg->parse(context);
-            parsed_args.emplace(arg);
-        } else {
-            // Neither a positional or a known option: throw an error
-            parse_errors.emplace_back("unknown argument '" + token + "'");
+            break;
+        }
+        case TokenAction::Kind::Error:
+            context.pop_next();
+            context.add_error(action.error, action.argument ? action.argument->index : NO_INDEX);
+            break;
         }
     }
 
-    // Print the help if either '-h' or '--help' is given.
-    if (help_request) {
-        help_request = false;
-        print_help();
+    end_parse(state);
+}
+
+void ParserSpec::parse_option(const Argument& arg, ArgumentParseContext& context, ParseState& state,
+                              bool bind) const {
+    // Verify that there are enough tokens for this argument
+    if (const unsigned int count = count_params(arg, context, state.grammar); count >= arg.min_params()) {
+        context.set_limit(count);
+        parse_argument(arg, context, state, bind);
+        context.reset_limit();
+    } else {
+        context.add_error(ParseErrorCode::MissingParameter, arg.index);
+    }
+}
+
+void ParserSpec::parse_command(const CommandNode& command, ArgumentParseContext& context, ParseState& state) const {
+    // Walk down the trie as long as the tokens name a subcommand
+    const CommandNode* node = &command;
+    while (context.has_next()) {
+        const CommandNode* child = node->find(context.seek_next());
+        if (!child) {
+            break;
+        }
+        context.pop_next();
+        node = child;
+    }
+
+    if (node->factory) {
+        state.command_ = node;
+    } else if (context.has_next() && is_command_word(context.seek_next())) {
+        // It's just a group of commands
+        context.pop_next();
+        context.add_error(ParseErrorCode::UnknownCommand);
+    } else {
+        context.add_error(ParseErrorCode::MissingCommand);
+    }
+}
+
+bool ParserSpec::is_command_word(std::string_view token) {
+    return !token.empty() && token[0] != '-';
+}
+
+bool ParserSpec::is_short_bundle(std::string_view token) const {
+    return token.size() > 2 && token[0] == '-' && token[1] != '-' && option_index.find_short(token[1]);
+}
+
+const CommandNode* ParserSpec::find_command(std::string_view token) const {
+    return commands.empty() ? nullptr : commands.front().find(token);
+}
+
+const Argument* ParserSpec::positional(unsigned int index) const {
+    return index < positionals.size() ? positionals[index] : nullptr;
+}
+
+void ParserSpec::parse_short_bundle(std::string_view token, ArgumentParseContext& context, ParseState& state,
+                                    bool bind) const {
+    for (std::size_t i = 1; i < token.size(); i++) {
+        const auto* const arg = option_index.find_short(token[i]);
+        if (!arg) {
+            context.add_error(ParseErrorCode::UnknownArgument);
+            return;
+        }
+
+        if (arg->max_params()) {
+            // The rest of the token (if any) is its first parameter (the only one, if it's variadic)
+            if (i + 1 < token.size()) {
+                context.attach(token.substr(i + 1));
+                limit_attached(*arg, context);
+            }
+            parse_option(*arg, context, state, bind);
+            context.reset_limit();
+            return;
+        }
+
+        // A flag
+        context.set_limit(0);
+        parse_argument(*arg, context, state, bind);
+        context.reset_limit();
+    }
+}
+
+ParserSpec::OptionMatch ParserSpec::match_option(std::string_view token) const {
+    OptionMatch match {};
+
+    if ((match.argument = option_index.find(token))) {
+        return match;
+    }
+
+    if (token.size() < 2 || token[0] != '-') {
+        return match;
+    }
+
+    // '--name=value': look up the name only, in place
+    if (const auto* eq = static_cast<const char*>(std::memchr(token.data(), '=', token.size()))) {
+        const auto name_size = static_cast<std::size_t>(eq - token.data());
+        match.value = token.substr(name_size + 1);
+        match.has_value = true;
+        token = token.substr(0, name_size);
+
+        if ((match.argument = option_index.find(token))) {
+            return match;
+        }
+    }
+
+    if (abbreviations_ && token.size() > 2 && token[1] == '-') {
+        match.argument = option_index.find_prefix(token, match.ambiguous);
+    }
+
+    return match;
+}
+
+bool ParserSpec::begin_parse(ParseState& state) const {
+    state.reset(arguments.size());
+
+    // Quit immediately if the parser is not properly setup
+    if (!setup_errors.empty()) {
+        for (const auto& error : setup_errors) {
+            state.errors_.add(error);
+        }
+        return false;
+    }
+
+    if (!frozen) {
+        state.errors_.add({ParseErrorCode::NotFrozen});
         return false;
     }
 
+    return true;
+}
+
+void ParserSpec::parse_argument(const Argument& arg, ArgumentParseContext& context, ParseState& state,
+                                bool bind) const {
+    if (arg.index == HELP_ARGUMENT_INDEX) {
+        state.help_request = true;
+    } else if (bind) {
+        arg.parse(context);
+    } else {
+        // Record the parameters so that they can be retrieved later
+        const auto offset = static_cast<unsigned int>(state.params.size());
+        context.record_params(&state.params);
+        arg.check(context);
+        context.record_params(nullptr);
+        state.add_params_span(arg.index, offset);
+    }
+    state.mark_parsed(arg.index);
+}
+
+void ParserSpec::end_parse(ParseState& state) const {
+    // Nothing else matters if the help is requested
+    if (state.help_request) {
+        return;
+    }
+
     // Check if we are missing some (required) argument
+    for (std::size_t w = 0; w < required_args.size(); w++) {
+        for (std::uint64_t missing = required_args[w] & ~state.parsed_args[w]; missing; missing &= missing - 1) {
+            const auto index = static_cast<unsigned int>(w * 64 + count_trailing_zeros(missing));
+            state.errors_.add({ParseErrorCode::MissingRequiredArgument, NO_INDEX, index});
+        }
+    }
+}
+
+std::string ParserSpec::format_error(const ParseError& error) const {
+    if (error.argument_index < arguments.size() && !arguments[error.argument_index].names.empty()) {
+        return Args::format_error(error, arguments[error.argument_index].names[0]);
+    }
+    return Args::format_error(error);
+}
+
+void ParserSpec::print_help(IOutputSink& out, unsigned int width) const {
+    print_help(out, width, false);
+}
+
+void ParserSpec::print_usage(IOutputSink& out, unsigned int width) const {
+    print_help(out, width, true);
+}
+
+std::vector<HelpEntry> ParserSpec::help_entries() const {
+    std::vector<HelpEntry> entries {};
+    entries.reserve(arguments.size() + commands.size());
     for (const auto& arg : arguments) {
-        if (arg->required_ && parsed_args.find(&*arg) == parsed_args.end()) {
-            parse_errors.emplace_back("missing required argument '" + arg->names[0] + "'");
+        entries.push_back(
+            {{arg.names.begin(), arg.names.end()}, arg.help_, arg.min_params(), arg.max_params(), arg.required_});
+    }
+    // Only the commands' names and help: their parsers are never set up for the help
+    for (const auto& command : commands) {
+        if (!command.factory) {
+            continue;
+        }
+        if (command.help.empty() && command.describe) {
+            // Laid out only once (and while holding the help cache's lock)
+            if (!command.described_help) {
+                command.described_help = command.describe();
+            }
+            entries.push_back({{command.path}, *command.described_help, 0, 0, false, true});
+        } else {
+            entries.push_back({{command.path}, command.help, 0, 0, false, true});
+        }
+    }
+    return entries;
+}
+
+void ParserSpec::print_help(IOutputSink& out, unsigned int width, bool usage_only) const {
+    help_cache->print(
+        width, usage_only,
+        [this] {
+            return help_entries();
+        },
+        out);
+}
+
+bool Parser::parse(unsigned int argc, char** argv, unsigned int from) {
+    if (response_files_) {
+        // Parse the expanded tokens instead (they are valid until the end of the parse)
+        ResponseFiles expanded {};
+        std::vector<std::string> errors {};
+        if (!expanded.expand(argc, argv, errors, from)) {
+            print_errors(errors, *error_sink);
+            return false;
         }
+
+        const auto& tokens = expanded.tokens();
+        return parse(tokens.data(), static_cast<unsigned int>(tokens.size()));
+    }
+
+    if (!frozen) {
+        freeze();
+    }
+
+    // Actually start parse (directly on argv, without copying the tokens)
+    ArgumentParseContext context {argv, argc, state.errors_, from};
+    return parse(context);
+}
+
+bool Parser::parse(const std::string_view* tokens, unsigned int count) {
+    if (!frozen) {
+        freeze();
+    }
+
+    ArgumentParseContext context {tokens, count, state.errors_};
+    return parse(context);
+}
+
+bool Parser::parse(ArgumentParseContext& context) {
+    command_parser_.reset();
+
+    ParserSpec::parse(context, state, true);
+
+    // Print the help if either '-h' or '--help' is given.
+    if (state.help_requested()) {
+        print_help(*help_sink, help_width_ ? help_width_ : terminal_width());
+        return false;
     }
 
     // Eventually dump parse errors
-    if (!parse_errors.empty()) {
-        print_errors(parse_errors);
+    if (!state.ok()) {
+        print_errors(*this, state.errors(), *error_sink);
         return false;
     }
 
+    if (state.command_) {
+        // The command's parser parses the rest of the tokens
+        Parser& command = setup_command(*state.command_);
+        ArgumentParseContext rest = context.rest(command.state.errors_);
+        return command.parse(rest);
+    }
+
     // Everything is ok
     return true;
 }
 
-void Parser::print_help() const {
-    static constexpr int max_width = 80;
+Parser& Parser::setup_command(const CommandNode& command) {
+    command_parser_ = std::make_unique<Parser>();
+    command_parser_->help_output(*help_sink).error_output(*error_sink).help_width(help_width_);
+    command.factory(*command_parser_);
+    if (!command_parser_->frozen) {
+        command_parser_->freeze();
+    }
+    return *command_parser_;
+}
+
+Parser& Parser::response_files(bool enable) {
+    response_files_ = enable;
+    return *this;
+}
 
-    // Helper data structures
+Parser& Parser::help_output(IOutputSink& sink) {
+    help_sink = &sink;
+    return *this;
+}
 
-    struct UsageEntry {
-        std::string name {};
-        std::optional<std::string> param_name {};
-        bool optional {};
-    };
+Parser& Parser::error_output(IOutputSink& sink) {
+    error_sink = &sink;
+    return *this;
+}
 
-    struct PositionalEntry {
-        std::string name {};
-        std::optional<std::string> help {};
-    };
+Parser& Parser::help_width(unsigned int width) {
+    help_width_ = width;
+    return *this;
+}
 
-    struct OptionEntry {
-        std::vector<std::string> names {};
-        std::optional<std::string> param_name {};
-        std::optional<std::string> help {};
+Parser& Parser::add_command(std::string_view path, std::string help, CommandFactory factory) {
+    if (CommandNode* node = emplace_command(path)) {
+        node->help = std::move(help);
+        node->factory = std::move(factory);
+        node->describe = {};
+    }
+    return *this;
+}
+
+Parser& Parser::add_plugin_command(std::string_view path, const std::string& library_path, std::string help) {
+    CommandNode* node = emplace_command(path);
+    if (!node) {
+        return *this;
+    }
+
+    // Many commands can be implemented by the same library: it's loaded once
+    auto it = std::find_if(plugins.begin(), plugins.end(), [&library_path](const auto& plugin) {
+        return plugin->path() == library_path;
+    });
+    const std::shared_ptr<Plugin> plugin =
+        it != plugins.end() ? *it : plugins.emplace_back(std::make_shared<Plugin>(library_path));
+
+    node->help = std::move(help);
+    node->factory = [plugin, command = node->path](Parser& parser) {
+        if (!plugin->setup_command(parser, command)) {
+            // The message is owned by the plugin, which outlives the parse
+            parser.setup_errors.push_back({ParseErrorCode::Custom, NO_INDEX, NO_INDEX, {}, plugin->error()});
+        }
     };
+    node->described_help.reset();
+    if (node->help.empty()) {
+        // Only then the help needs the library
+        node->describe = [plugin, command = node->path] {
+            return plugin->command_help(command);
+        };
+    } else {
+        node->describe = {};
+    }
+
+    return *this;
+}
+
+bool Parser::was_set(const ArgumentConfig& arg) const {
+    return state.was_set(arg);
+}
+
+std::string_view Parser::command() const {
+    return state.command();
+}
+
+Parser* Parser::command_parser() const {
+    return command_parser_.get();
+}
+
+void HelpCache::clear() {
+    std::lock_guard lock {mutex};
+    layout.reset();
+    text.clear();
+}
+
+void print_help(const std::vector<HelpEntry>& entries, IOutputSink& out) {
+    const std::string text = render_help(entries);
+    out.write(text.data(), text.size());
+}
+
+std::string render_help(const std::vector<HelpEntry>& entries, unsigned int width) {
+    return render_help(layout_help(entries), width);
+}
 
+HelpLayout layout_help(const std::vector<HelpEntry>& entries) {
     // Helper functions
 
-    const auto is_help_argument = [](const Argument* arg) {
+    const auto is_help_argument = [](const HelpEntry* arg) {
         return arg->names[0] == "--help";
     };
 
-    const auto is_option_argument = [](const Argument* arg) {
+    const auto is_option_argument = [](const HelpEntry* arg) {
         return arg->names[0][0] == '-';
     };
 
-    const auto find_argument_longest_name = [](const Argument* arg) {
+    const auto find_argument_longest_name = [](const HelpEntry* arg) {
         return *std::max_element(arg->names.begin(), arg->names.end(),
-                                 [](const std::string& s1, const std::string& s2) {
+                                 [](std::string_view s1, std::string_view s2) {
                                      return s1.size() < s2.size();
                                  });
     };
 
-    std::vector<UsageEntry> usage {};
-    std::vector<PositionalEntry> positional_entries {};
-    std::vector<OptionEntry> option_entries {};
-
-    unsigned int args_col_width = 0;
-
-    // Sort the arguments so that all the positionals precede the options (and help is last)
-    std::vector<Argument*> sorted_arguments {};
-    sorted_arguments.resize(arguments.size());
-    std::transform(arguments.begin(), arguments.end(), sorted_arguments.begin(),
-                   [](const std::unique_ptr<Argument>& arg) {
-                       return &*arg;
-                   });
-    std::sort(sorted_arguments.begin(), sorted_arguments.end(),
-              [is_option_argument, is_help_argument](const Argument* a1, const Argument* a2) {
-                  // Help is always last
-                  if (is_help_argument(a1) != is_help_argument(a2))
-                      return is_help_argument(a2);
-
-                  // The positionals precede the options
-                  return is_option_argument(a1) < is_option_argument(a2);
-              });
+    HelpLayout layout {};
+    auto& usage = layout.usage;
+    auto& positional_entries = layout.positional_entries;
+    auto& command_entries = layout.command_entries;
+    auto& option_entries = layout.option_entries;
+    auto& args_col_width = layout.args_col_width;
+
+    // Sort the arguments so that all the positionals precede the commands and the options (and help is last)
+    std::vector<const HelpEntry*> sorted_arguments {};
+    sorted_arguments.resize(entries.size());
+    std::transform(entries.begin(), entries.end(), sorted_arguments.begin(), [](const HelpEntry& entry) {
+        return &entry;
+    });
+    std::stable_sort(sorted_arguments.begin(), sorted_arguments.end(),
+                     [is_option_argument, is_help_argument](const HelpEntry* a1, const HelpEntry* a2) {
+                         // Help is always last
+                         if (is_help_argument(a1) != is_help_argument(a2))
+                             return is_help_argument(a2);
+
+                         // The positionals precede the commands, which precede the options
+                         const auto rank = [is_option_argument](const HelpEntry* arg) {
+                             return arg->command ? 1 : is_option_argument(arg) ? 2 : 0;
+                         };
+                         return rank(a1) < rank(a2);
+                     });
 
     // Iterate all the arguments and fill the data structures
     for (const auto* arg : sorted_arguments) {
+        if (arg->command) {
+            // The commands are a single entry of the usage
+            if (command_entries.empty()) {
+                usage.push_back({"COMMAND", "...", true});
+            }
+            command_entries.push_back({arg->names[0], arg->help});
+            args_col_width = std::max(args_col_width, display_width(arg->names[0]) + 2);
+            continue;
+        }
+
         // Find the primary name of this argument (i.e. the longest one)
-        const std::string& primary_name = find_argument_longest_name(arg);
+        const std::string_view primary_name = find_argument_longest_name(arg);
 
         // Find out if this is an option or a positional argument from its name
         const bool is_option = is_option_argument(arg);
 
         // FInd out if it's optional or mandatory
-        const bool is_optional = !arg->required_;
+        const bool is_optional = !arg->required;
 
         // Compute the parameter name as the primary name without leading dashes upper case
+        // (followed by ellipsis if it takes more parameters)
         std::optional<std::string> param_name {};
-        if (is_option && arg->num_params()) {
-            std::string s = primary_name.substr(primary_name.find_first_not_of('-'));
+        if (is_option && arg->max_params) {
+            std::string s {primary_name.substr(primary_name.find_first_not_of('-'))};
             std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) {
                 return std::toupper(c);
             });
+            if (arg->max_params > 1) {
+                s += "...";
+            }
             param_name = s;
         }
 
@@ -280,64 +1254,120 @@ void Parser::print_help() const {
 
         if (is_option) {
             // Add the option
-            std::vector<std::string> sorted_names = arg->names;
+            std::vector<std::string_view> sorted_names = arg->names;
             std::sort(sorted_names.begin(), sorted_names.end(), std::greater<>());
-            option_entries.push_back({sorted_names, param_name, arg->help_});
+            option_entries.push_back({sorted_names, param_name, arg->help});
         } else {
             // Add the positional entry
-            positional_entries.push_back({primary_name, arg->help_});
+            positional_entries.push_back({primary_name, arg->help});
         }
 
         // Update args_col_width with the known maximum of all the arguments' name + param strings
         unsigned arg_col_width = 0;
-        std::for_each(arg->names.begin(), arg->names.end(), [&arg_col_width](const std::string& s) {
-            arg_col_width += s.size() + 2 /* comma + space */;
+        std::for_each(arg->names.begin(), arg->names.end(), [&arg_col_width](std::string_view s) {
+            arg_col_width += display_width(s) + 2 /* comma + space */;
         });
-        arg_col_width += param_name ? (param_name->size() + 1 /* space */) : 0;
+        arg_col_width += param_name ? (display_width(*param_name) + 1 /* space */) : 0;
         args_col_width = std::max(args_col_width, arg_col_width);
     }
 
+    return layout;
+}
+
+std::string render_help(const HelpLayout& layout, unsigned int max_width) {
+    // Below this width the descriptions go on their own rows, under the names
+    static constexpr unsigned int min_help_width = 20;
+
+    const auto& [usage, positional_entries, command_entries, option_entries, args_col_width] = layout;
+
+    // The whole help is rendered first, then written at once
+    std::string text {};
+
     // Print usage
     {
-        std::stringstream ss {};
+        std::string s {};
         for (unsigned int i = 0; i < usage.size(); i++) {
             const auto& [name, param_name, is_optional] = usage[i];
-            ss << (is_optional ? "[" : "");
-            ss << name << (param_name ? (" " + *param_name) : "");
-            ss << (is_optional ? "]" : "");
-            ss << ((i < usage.size() - 1) ? " " : "");
+            s += is_optional ? "[" : "";
+            s += name;
+            s += param_name ? (" " + *param_name) : "";
+            s += is_optional ? "]" : "";
+            s += (i < usage.size() - 1) ? " " : "";
         }
 
-        std::cout << "usage: " << wrap(ss.str(), 7, max_width) << std::endl << std::endl;
+        text += "usage: ";
+        wrap(text, s, 7, max_width, 7);
+        text += "\n\n";
     }
 
-    static const std::string pad = "  ";
+    static constexpr std::string_view pad = "  ";
+
+    const unsigned int col_width = args_col_width;
+    const bool stacked = pad.size() + col_width + min_help_width > max_width;
+
+    // Left aligns the names column (rendered from column_begin) and wraps the help after it
+    const auto append_help = [&text, col_width, max_width, stacked](std::size_t column_begin, std::string_view help) {
+        if (stacked) {
+            // Too narrow for two columns
+            if (help.find_first_not_of(" \f\n\r\t\v") != std::string_view::npos) {
+                text += '\n';
+                text.append(2 * pad.size(), ' ');
+                wrap(text, help, 2 * pad.size(), max_width, 2 * pad.size());
+            }
+            text += '\n';
+            return;
+        }
+
+        const unsigned int column_width = display_width(std::string_view {text}.substr(column_begin));
+        if (column_width < col_width) {
+            text.append(col_width - column_width, ' ');
+        }
+        wrap(text, help, col_width + pad.size(), max_width, pad.size() + std::max(column_width, col_width));
+        text += '\n';
+    };
 
     // Print positional arguments
     {
-        std::cout << "positional arguments:" << std::endl;
+        text += "positional arguments:\n";
         for (const auto& [name, help] : positional_entries) {
-            std::stringstream ss;
-            ss << pad << std::left << std::setw(static_cast<int>(args_col_width)) << name << help.value_or("");
-            std::cout << wrap(ss.str(), args_col_width + pad.size(), max_width) << std::endl;
+            text += pad;
+            const std::size_t column_begin = text.size();
+            text += name;
+            append_help(column_begin, help);
         }
-        std::cout << std::endl;
+        text += "\n";
+    }
+
+    // Print commands
+    if (!command_entries.empty()) {
+        text += "commands:\n";
+        for (const auto& [name, help] : command_entries) {
+            text += pad;
+            const std::size_t column_begin = text.size();
+            text += name;
+            append_help(column_begin, help);
+        }
+        text += "\n";
     }
 
     // Print options
     {
-        std::cout << "options:" << std::endl;
+        text += "options:\n";
         for (const auto& [names, param_name, help] : option_entries) {
-            std::stringstream ss1;
+            text += pad;
+            const std::size_t column_begin = text.size();
             for (unsigned int i = 0; i < names.size(); i++) {
-                ss1 << names[i] << ((i < names.size() - 1) ? ", " : "");
+                text += names[i];
+                text += (i < names.size() - 1) ? ", " : "";
             }
-            ss1 << (param_name ? (" " + *param_name) : "");
-
-            std::stringstream ss2;
-            ss2 << pad << std::left << std::setw(static_cast<int>(args_col_width)) << ss1.str() << help.value_or("");
-            std::cout << wrap(ss2.str(), args_col_width + pad.size(), max_width) << std::endl;
+            if (param_name) {
+                text += ' ';
+                text += *param_name;
+            }
+            append_help(column_begin, help);
         }
     }
+
+    return text;
 }
 } // namespace Args
@@ -0,0 +1,183 @@
+#include "args/batch.h"
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Args {
+
+namespace {
+    // Lines are handed out in chunks, so that the synchronization cost is amortized
+    constexpr std::size_t CHUNK_SIZE = 64;
+
+    // Range of lines still to be parsed owned by a worker (and stealable by the others)
+    struct alignas(64) WorkQueue {
+        std::mutex mutex {};
+        std::size_t begin {};
+        std::size_t end {};
+    };
+
+    bool pop_chunk(WorkQueue& queue, std::size_t& begin, std::size_t& end) {
+        std::lock_guard lock {queue.mutex};
+        if (queue.begin == queue.end) {
+            return false;
+        }
+        begin = queue.begin;
+        end = std::min(queue.begin + CHUNK_SIZE, queue.end);
+        queue.begin = end;
+        return true;
+    }
+
+    bool steal_half(WorkQueue& victim, WorkQueue& thief) {
+        std::size_t begin {}, end {};
+        {
+            // Take the second half of the victim's remaining lines
+            std::lock_guard lock {victim.mutex};
+            const std::size_t remaining = victim.end - victim.begin;
+            if (!remaining) {
+                return false;
+            }
+            end = victim.end;
+            begin = victim.end - (remaining + 1) / 2;
+            victim.end = begin;
+        }
+        std::lock_guard lock {thief.mutex};
+        thief.begin = begin;
+        thief.end = end;
+        return true;
+    }
+} // namespace
+
+std::size_t BatchResult::size() const {
+    return ok_.size();
+}
+
+std::size_t BatchResult::num_failed() const {
+    return num_failed_;
+}
+
+bool BatchResult::ok(std::size_t line) const {
+    return ok_[line];
+}
+
+std::vector<ParseError> BatchResult::errors(std::size_t line) const {
+    std::vector<ParseError> out {};
+    auto it = std::lower_bound(errors_.begin(), errors_.end(), line, [](const LineError& e, std::size_t l) {
+        return e.line < l;
+    });
+    for (; it != errors_.end() && it->line == line; ++it) {
+        out.push_back(it->error);
+    }
+    return out;
+}
+
+std::size_t BatchResult::dropped(std::size_t line) const {
+    const auto it = std::lower_bound(dropped_.begin(), dropped_.end(), line, [](const LineDropped& d, std::size_t l) {
+        return d.line < l;
+    });
+    return it != dropped_.end() && it->line == line ? it->count : 0;
+}
+
+BatchResult parse_batch(const ParserSpec& spec, const CommandLine* lines, std::size_t count,
+                        const std::function<void(std::size_t, const ParseState&)>& on_parsed,
+                        unsigned int num_threads) {
+    BatchResult result {};
+    result.ok_.resize(count);
+
+    if (!num_threads) {
+        num_threads = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+
+    // No point in having more workers than chunks
+    const std::size_t num_chunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    const std::size_t num_workers = std::max<std::size_t>(std::min<std::size_t>(num_threads, num_chunks), 1);
+
+    // Split the lines evenly among the workers
+    std::unique_ptr<WorkQueue[]> queues {new WorkQueue[num_workers]};
+    for (std::size_t w = 0; w < num_workers; w++) {
+        queues[w].begin = count * w / num_workers;
+        queues[w].end = count * (w + 1) / num_workers;
+    }
+
+    std::vector<std::vector<BatchResult::LineError>> worker_errors(num_workers);
+    std::vector<std::vector<BatchResult::LineDropped>> worker_dropped(num_workers);
+    std::vector<std::deque<std::string>> worker_messages(num_workers);
+
+    const auto work = [&](std::size_t w) {
+        // Scratch buffers reused for all the lines parsed by this worker
+        ParseState state {};
+        auto& errors = worker_errors[w];
+        auto& dropped = worker_dropped[w];
+        auto& messages = worker_messages[w];
+
+        while (true) {
+            std::size_t begin {}, end {};
+
+            if (!pop_chunk(queues[w], begin, end)) {
+                // Out of work: try to steal from the other workers
+                bool stolen = false;
+                for (std::size_t k = 1; k < num_workers && !stolen; k++) {
+                    stolen = steal_half(queues[(w + k) % num_workers], queues[w]);
+                }
+                if (!stolen) {
+                    return;
+                }
+                continue;
+            }
+
+            for (std::size_t i = begin; i < end; i++) {
+                const bool ok = spec.parse(lines[i].tokens, lines[i].count, state);
+                result.ok_[i] = ok;
+                if (!ok) {
+                    for (ParseError error : state.errors()) {
+                        // Custom messages are owned by the state, which is reused: keep a copy
+                        if (error.code == ParseErrorCode::Custom) {
+                            error.message = messages.emplace_back(error.message);
+                        }
+                        errors.push_back({i, error});
+                    }
+                    if (state.errors().dropped()) {
+                        dropped.push_back({i, state.errors().dropped()});
+                    }
+                }
+                if (on_parsed) {
+                    on_parsed(i, state);
+                }
+            }
+        }
+    };
+
+    // The calling thread is a worker too
+    std::vector<std::thread> threads {};
+    threads.reserve(num_workers - 1);
+    for (std::size_t w = 1; w < num_workers; w++) {
+        threads.emplace_back(work, w);
+    }
+    work(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Merge the errors of all the workers
+    for (auto& errors : worker_errors) {
+        std::move(errors.begin(), errors.end(), std::back_inserter(result.errors_));
+    }
+    std::stable_sort(result.errors_.begin(), result.errors_.end(),
+                     [](const BatchResult::LineError& e1, const BatchResult::LineError& e2) {
+                         return e1.line < e2.line;
+                     });
+    for (auto& dropped : worker_dropped) {
+        std::move(dropped.begin(), dropped.end(), std::back_inserter(result.dropped_));
+    }
+    std::sort(result.dropped_.begin(), result.dropped_.end(),
+              [](const BatchResult::LineDropped& d1, const BatchResult::LineDropped& d2) {
+                  return d1.line < d2.line;
+              });
+    result.messages_ = std::move(worker_messages);
+
+    result.num_failed_ = std::count(result.ok_.begin(), result.ok_.end(), 0);
+
+    return result;
+}
+} // namespace Args
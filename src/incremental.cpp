@@ -0,0 +1,252 @@
+#include "args/incremental.h"
+#include <utility>
+
+namespace Args {
+IncrementalParser::IncrementalParser(Parser& parser) :
+    parser {parser} {
+    reset();
+}
+
+IncrementalParser::FeedResult IncrementalParser::feed(std::string_view token) {
+    if (command_) {
+        // The rest of the tokens belong to the command
+        num_fed++;
+        return command_->feed(token);
+    }
+
+    if (!state_.errors_.empty()) {
+        return FeedResult::Failed;
+    }
+
+    const unsigned int token_index = num_fed++;
+    bool parsed = false;
+
+    if (command_node) {
+        return feed_command_word(token, token_index);
+    }
+
+    if (pending) {
+        if (pending_min_params == pending_max_params || !parser.ends_params(token, state_.grammar)) {
+            // It's a parameter of the pending argument
+            add_param(token, token_index);
+            return pending_ends.size() < pending_max_params ? FeedResult::Pending : parse_pending();
+        }
+
+        // Another argument ends the parameters of the pending (variadic) argument
+        if (parse_pending() == FeedResult::Failed) {
+            return FeedResult::Failed;
+        }
+        parsed = true;
+    }
+
+    // The same decisions of Parser::parse(), but the parameters are collected as they are fed
+    switch (const ParserSpec::TokenAction action = parser.next_action(token, state_.grammar); action.kind) {
+    case ParserSpec::TokenAction::Kind::EndOptions:
+        return parsed ? FeedResult::Parsed : FeedResult::Pending;
+    case ParserSpec::TokenAction::Kind::Option:
+        // Wait for its parameters (if any)
+        begin_pending(*action.argument, token, token_index);
+        if (action.has_value) {
+            // '--name=value': the value is its first parameter (the only one, if it's variadic)
+            add_param(action.value, token_index);
+            limit_attached();
+        }
+        break;
+    case ParserSpec::TokenAction::Kind::ShortBundle:
+        if (!begin_short_bundle(token, token_index)) {
+            return FeedResult::Failed;
+        }
+        if (!pending) {
+            return FeedResult::Parsed;
+        }
+        break;
+    case ParserSpec::TokenAction::Kind::Command:
+        // Its parser is set up once the following tokens don't name a subcommand
+        command_node = action.command;
+        command_index = token_index;
+        return parsed ? FeedResult::Parsed : FeedResult::Pending;
+    case ParserSpec::TokenAction::Kind::Positional:
+        // This token is its first parameter
+        begin_pending(*action.argument, token, token_index);
+        add_param(token, token_index);
+        break;
+    case ParserSpec::TokenAction::Kind::Error:
+        // Fed tokens don't outlive the call: the error keeps its own copy
+        state_.errors_.add({action.error, token_index, action.argument ? action.argument->index : NO_INDEX, token});
+        state_.errors_.persist();
+        return FeedResult::Failed;
+    }
+
+    if (pending_ends.size() < pending_max_params) {
+        return parsed ? FeedResult::Parsed : FeedResult::Pending;
+    }
+
+    return parse_pending();
+}
+
+bool IncrementalParser::finish() {
+    if (state_.errors_.empty() && command_node && !begin_command(nullptr, num_fed)) {
+        return false;
+    }
+
+    if (command_) {
+        return command_->finish();
+    }
+
+    if (state_.errors_.empty() && pending) {
+        parse_pending();
+    }
+
+    if (state_.errors_.empty()) {
+        parser.end_parse(state_);
+    }
+
+    return state_.ok();
+}
+
+void IncrementalParser::reset() {
+    if (!parser.frozen) {
+        parser.freeze();
+    }
+    parser.begin_parse(state_);
+    pending = nullptr;
+    pending_buffer.clear();
+    pending_ends.clear();
+    num_fed = 0;
+    command_node = nullptr;
+    command_.reset();
+    parser.command_parser_.reset();
+}
+
+const ParseState& IncrementalParser::state() const {
+    return state_;
+}
+
+IncrementalParser* IncrementalParser::command() const {
+    return command_.get();
+}
+
+void IncrementalParser::begin_pending(const Argument& arg, std::string_view name, unsigned int token_index) {
+    pending = &arg;
+    pending_index = token_index;
+    pending_min_params = arg.min_params();
+    pending_max_params = arg.max_params();
+    pending_name = name;
+}
+
+bool IncrementalParser::begin_short_bundle(std::string_view token, unsigned int token_index) {
+    for (std::size_t i = 1; i < token.size(); i++) {
+        const auto* const arg = parser.option_index.find_short(token[i]);
+        if (!arg) {
+            state_.errors_.add({ParseErrorCode::UnknownArgument, token_index, NO_INDEX, token});
+            state_.errors_.persist();
+            return false;
+        }
+
+        if (arg->max_params()) {
+            // The rest of the token (if any) is its first parameter (the only one, if it's variadic)
+            begin_pending(*arg, token, token_index);
+            if (i + 1 < token.size()) {
+                add_param(token.substr(i + 1), token_index);
+                limit_attached();
+            }
+            return true;
+        }
+
+        // A flag
+        ArgumentParseContext context {static_cast<const std::string_view*>(nullptr), 0, state_.errors_};
+        parser.parse_argument(*arg, context, state_, true);
+    }
+
+    return true;
+}
+
+void IncrementalParser::limit_attached() {
+    if (pending_min_params != pending_max_params) {
+        pending_max_params = 1;
+    }
+}
+
+void IncrementalParser::add_param(std::string_view token, unsigned int token_index) {
+    if (pending_ends.empty()) {
+        pending_params_index = token_index;
+    }
+    pending_buffer.append(token);
+    pending_ends.push_back(pending_buffer.size());
+}
+
+IncrementalParser::FeedResult IncrementalParser::parse_pending() {
+    if (pending_ends.size() < pending_min_params) {
+        state_.errors_.add({ParseErrorCode::MissingParameter, pending_index, pending->index, pending_name});
+        state_.errors_.persist();
+        return FeedResult::Failed;
+    }
+
+    // The buffer is no longer modified: build the views over it
+    pending_params.clear();
+    std::size_t begin = 0;
+    for (const std::size_t end : pending_ends) {
+        pending_params.emplace_back(pending_buffer.data() + begin, end - begin);
+        begin = end;
+    }
+
+    ArgumentParseContext context {pending_params.data(), static_cast<unsigned int>(pending_params.size()),
+                                  state_.errors_};
+    context.set_token_offset(pending_params_index);
+    parser.parse_argument(*pending, context, state_, true);
+
+    // The errors refer to the buffer of the parameters, which is going to be reused
+    const bool failed = !state_.errors_.empty();
+    if (failed) {
+        state_.errors_.persist();
+    }
+
+    pending = nullptr;
+    pending_buffer.clear();
+    pending_ends.clear();
+
+    return failed ? FeedResult::Failed : FeedResult::Parsed;
+}
+
+IncrementalParser::FeedResult IncrementalParser::feed_command_word(std::string_view token, unsigned int token_index) {
+    // Walk down the trie as long as the tokens name a subcommand
+    if (const CommandNode* child = command_node->find(token)) {
+        command_node = child;
+        command_index = token_index;
+        return FeedResult::Pending;
+    }
+
+    if (!begin_command(&token, token_index)) {
+        return FeedResult::Failed;
+    }
+    return command_->feed(token);
+}
+
+bool IncrementalParser::begin_command(const std::string_view* next, unsigned int token_index) {
+    const CommandNode* node = std::exchange(command_node, nullptr);
+
+    if (!node->factory) {
+        // It's just a group of commands
+        if (next && ParserSpec::is_command_word(*next)) {
+            state_.errors_.add({ParseErrorCode::UnknownCommand, token_index, NO_INDEX, *next});
+        } else {
+            state_.errors_.add({ParseErrorCode::MissingCommand, command_index, NO_INDEX, node->name});
+        }
+        state_.errors_.persist();
+        return false;
+    }
+
+    // The arguments preceding the command are complete
+    state_.command_ = node;
+    parser.end_parse(state_);
+    if (!state_.errors_.empty()) {
+        state_.errors_.persist();
+        return false;
+    }
+
+    command_ = std::make_unique<IncrementalParser>(parser.setup_command(*node));
+    // Its tokens are numbered as the whole input's
+    command_->num_fed = token_index;
+    return true;
+}
+} // namespace Args
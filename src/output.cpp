@@ -0,0 +1,76 @@
+#include "args/args.h"
+#include <cerrno>
+#include <cstdlib>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/ioctl.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <io.h>
+#include <windows.h>
+#endif
+
+namespace Args {
+FileDescriptorSink::FileDescriptorSink(int fd) :
+    fd {fd} {
+}
+
+void FileDescriptorSink::write(const char* data, std::size_t size) {
+    while (size) {
+#if defined(_WIN32)
+        const int n = ::_write(fd, data, static_cast<unsigned int>(size));
+#else
+        const auto n = ::write(fd, data, size);
+#endif
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Nowhere to report the failure
+            return;
+        }
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+}
+
+IOutputSink& standard_output() {
+    static FileDescriptorSink sink {1};
+    return sink;
+}
+
+IOutputSink& standard_error() {
+    static FileDescriptorSink sink {2};
+    return sink;
+}
+
+unsigned int terminal_width() {
+    static const unsigned int width = [] {
+        // Size of the terminal the standard output is attached to
+#if defined(TIOCGWINSZ)
+        winsize size {};
+        if (ioctl(1, TIOCGWINSZ, &size) == 0 && size.ws_col) {
+            return static_cast<unsigned int>(size.ws_col);
+        }
+#elif defined(_WIN32)
+        CONSOLE_SCREEN_BUFFER_INFO info {};
+        if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+            return static_cast<unsigned int>(info.srWindow.Right - info.srWindow.Left + 1);
+        }
+#endif
+
+        // Not a terminal: respect COLUMNS, if set
+        if (const char* columns = std::getenv("COLUMNS")) {
+            if (const long n = std::strtol(columns, nullptr, 10); n > 0) {
+                return static_cast<unsigned int>(n);
+            }
+        }
+
+        return DEFAULT_HELP_WIDTH;
+    }();
+
+    return width;
+}
+} // namespace Args
@@ -0,0 +1,78 @@
+#include "args/plugin.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <dlfcn.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+namespace Args {
+Plugin::Plugin(std::string path) :
+    path_ {std::move(path)} {
+}
+
+bool Plugin::load() {
+    std::lock_guard lock {mutex};
+
+    if (attempted) {
+        return setup != nullptr;
+    }
+    attempted = true;
+
+#if defined(__unix__) || defined(__APPLE__)
+    handle = dlopen(path_.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        const char* reason = dlerror();
+        error_ = "failed to load plugin '" + path_ + "'" + (reason ? std::string {": "} + reason : "");
+        return false;
+    }
+    setup = reinterpret_cast<SetupFunction>(dlsym(handle, SETUP_SYMBOL));
+    help = reinterpret_cast<HelpFunction>(dlsym(handle, HELP_SYMBOL));
+#elif defined(_WIN32)
+    HMODULE module = LoadLibraryA(path_.c_str());
+    handle = module;
+    if (!module) {
+        error_ = "failed to load plugin '" + path_ + "'";
+        return false;
+    }
+    setup = reinterpret_cast<SetupFunction>(GetProcAddress(module, SETUP_SYMBOL));
+    help = reinterpret_cast<HelpFunction>(GetProcAddress(module, HELP_SYMBOL));
+#else
+    error_ = "plugins are not supported on this platform";
+    return false;
+#endif
+
+    if (!setup) {
+        error_ = "plugin '" + path_ + "' doesn't export " + SETUP_SYMBOL;
+        return false;
+    }
+
+    return true;
+}
+
+bool Plugin::setup_command(Parser& parser, const std::string& command) {
+    if (!load()) {
+        return false;
+    }
+    setup(parser, command.c_str());
+    return true;
+}
+
+std::string Plugin::command_help(const std::string& command) {
+    if (!load() || !help) {
+        return {};
+    }
+    const char* text = help(command.c_str());
+    return text ? text : "";
+}
+
+const std::string& Plugin::path() const {
+    return path_;
+}
+
+const std::string& Plugin::error() const {
+    return error_;
+}
+} // namespace Args
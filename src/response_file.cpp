@@ -0,0 +1,130 @@
+#include "args/response_file.h"
+#include <algorithm>
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ARGS_HAS_MMAP
+#endif
+
+namespace Args {
+
+namespace {
+    bool is_response_file(std::string_view token) {
+        return token.size() > 1 && token[0] == '@';
+    }
+} // namespace
+
+ResponseFiles::~ResponseFiles() {
+    for (const auto& file : files) {
+#ifdef ARGS_HAS_MMAP
+        if (file.mapped) {
+            munmap(file.data, file.size);
+            continue;
+        }
+#endif
+        delete[] file.data;
+    }
+}
+
+bool ResponseFiles::expand(unsigned int argc, const char* const* argv, std::vector<std::string>& errors,
+                           unsigned int from) {
+    tokens_.clear();
+    tokens_.reserve(argc - std::min(from, argc));
+
+    bool ok = true;
+    for (unsigned int i = from; i < argc && ok; i++) {
+        ok = expand(argv[i], 0, errors);
+    }
+    return ok;
+}
+
+const std::vector<std::string_view>& ResponseFiles::tokens() const {
+    return tokens_;
+}
+
+bool ResponseFiles::expand(std::string_view token, unsigned int depth, std::vector<std::string>& errors) {
+    if (!is_response_file(token)) {
+        tokens_.push_back(token);
+        return true;
+    }
+    return load(token.substr(1), depth, errors);
+}
+
+bool ResponseFiles::load(std::string_view path, unsigned int depth, std::vector<std::string>& errors) {
+    if (depth >= MAX_DEPTH) {
+        errors.emplace_back("too many nested response files at '" + std::string {path} + "'");
+        return false;
+    }
+
+    const std::string path_str {path};
+    File file {};
+
+#ifdef ARGS_HAS_MMAP
+    const int fd = open(path_str.c_str(), O_RDONLY);
+    if (fd < 0) {
+        errors.emplace_back("failed to open response file '" + path_str + "'");
+        return false;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        // Private mapping: the in place split never reaches the file
+        void* data = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            file = {static_cast<char*>(data), static_cast<std::size_t>(st.st_size), true};
+        }
+    }
+    close(fd);
+
+    if (!file.mapped && st.st_size > 0) {
+        errors.emplace_back("failed to map response file '" + path_str + "'");
+        return false;
+    }
+#else
+    std::FILE* f = std::fopen(path_str.c_str(), "rb");
+    if (!f) {
+        errors.emplace_back("failed to open response file '" + path_str + "'");
+        return false;
+    }
+    std::fseek(f, 0, SEEK_END);
+    const long size = std::ftell(f);
+    std::fseek(f, 0, SEEK_SET);
+    if (size > 0) {
+        file.data = new char[size];
+        file.size = std::fread(file.data, 1, size, f);
+    }
+    std::fclose(f);
+#endif
+
+    files.push_back(file);
+
+    // Split directly into the tokens
+    const std::size_t first = tokens_.size();
+    if (!split_in_place(file.data, file.data + file.size, tokens_)) {
+        errors.emplace_back("unterminated quote in response file '" + path_str + "'");
+        return false;
+    }
+
+    // Expand the nested response files, if any
+    const auto nested = std::find_if(tokens_.begin() + first, tokens_.end(), is_response_file);
+    if (nested == tokens_.end()) {
+        return true;
+    }
+
+    std::vector<std::string_view> tail {nested, tokens_.end()};
+    tokens_.erase(nested, tokens_.end());
+
+    for (const auto token : tail) {
+        if (!expand(token, depth + 1, errors)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+} // namespace Args
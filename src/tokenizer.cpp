@@ -0,0 +1,191 @@
+#include "args/tokenizer.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ARGS_HAS_SSE2
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace Args {
+
+namespace {
+    bool is_whitespace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+    }
+
+    bool is_special(char c) {
+        return is_whitespace(c) || c == '\'' || c == '"' || c == '\\';
+    }
+
+    // Returns the first whitespace, quote or backslash in [p, end), or end
+    const char* find_special(const char* p, const char* end) {
+#ifdef ARGS_HAS_SSE2
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i single_quote = _mm_set1_epi8('\'');
+        const __m128i double_quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i four = _mm_set1_epi8(4);
+
+        while (end - p >= 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+
+            // '\t', '\n', '\v', '\f', '\r' are contiguous: (c - '\t') <= 4, unsigned
+            const __m128i from_tab = _mm_sub_epi8(chunk, tab);
+            const __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(from_tab, four), from_tab);
+
+            const __m128i special =
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), control),
+                             _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, single_quote),
+                                                       _mm_cmpeq_epi8(chunk, double_quote)),
+                                          _mm_cmpeq_epi8(chunk, backslash)));
+
+            if (const unsigned int mask = _mm_movemask_epi8(special)) {
+#ifdef _MSC_VER
+                unsigned long index {};
+                _BitScanForward(&index, mask);
+                return p + index;
+#else
+                return p + __builtin_ctz(mask);
+#endif
+            }
+
+            p += 16;
+        }
+#endif
+        while (p != end && !is_special(*p)) {
+            p++;
+        }
+        return p;
+    }
+
+    // Unquotes the token starting at p into w (which may alias p, as long as w <= p),
+    // up to the first whitespace outside quotes.
+    // Returns the end of the written token, or nullptr if a quote is not terminated.
+    char* unquote(const char*& p, const char* end, char* w) {
+        while (p != end && !is_whitespace(*p)) {
+            if (*p == '\'') {
+                // Single quotes: everything is literal
+                p++;
+                while (p != end && *p != '\'') {
+                    *w++ = *p++;
+                }
+                if (p == end) {
+                    return nullptr;
+                }
+                p++;
+            } else if (*p == '"') {
+                // Double quotes: only '"' and '\' can be escaped
+                p++;
+                while (p != end && *p != '"') {
+                    if (*p == '\\' && p + 1 != end && (p[1] == '"' || p[1] == '\\')) {
+                        p++;
+                    }
+                    *w++ = *p++;
+                }
+                if (p == end) {
+                    return nullptr;
+                }
+                p++;
+            } else if (*p == '\\') {
+                // Escape: the next character is literal, a newline is removed
+                p++;
+                if (p == end) {
+                    break;
+                }
+                if (*p == '\n') {
+                    p++;
+                } else {
+                    *w++ = *p++;
+                }
+            } else {
+                *w++ = *p++;
+            }
+        }
+        return w;
+    }
+
+    /*
+     * Splits [begin, end) into tokens: tokens without quotes and escapes are views over the source,
+     * the others are handed to unquote_token(token_begin, p), with p at the first quote or escape,
+     * which has to push them and return their end (or null if a quote is not terminated).
+     */
+    template <typename Unquote>
+    bool split(const char* begin, const char* end, std::vector<std::string_view>& tokens, Unquote&& unquote_token) {
+        const char* p = begin;
+
+        while (true) {
+            // Skip the whitespaces preceding the token
+            while (p != end && is_whitespace(*p)) {
+                p++;
+            }
+            if (p == end) {
+                return true;
+            }
+
+            const char* const token_begin = p;
+            p = find_special(p, end);
+
+            if (p == end || is_whitespace(*p)) {
+                // Fast path: plain token
+                tokens.emplace_back(token_begin, p - token_begin);
+            } else {
+                // Slow path: there's a quote or an escape
+                const char* const token_end = unquote_token(token_begin, p);
+                if (!token_end) {
+                    return false;
+                }
+            }
+        }
+    }
+} // namespace
+
+bool Tokenizer::tokenize(std::string_view command_line) {
+    tokens_.clear();
+
+    // Unquoted tokens are never longer than the command line
+    if (buffer_capacity < command_line.size()) {
+        buffer.reset(new char[command_line.size()]);
+        buffer_capacity = command_line.size();
+    }
+
+    char* w = buffer.get();
+
+    return split(command_line.data(), command_line.data() + command_line.size(), tokens_,
+                 [this, &w, end = command_line.data() + command_line.size()](const char* token_begin,
+                                                                             const char*& p) -> const char* {
+                     // Copy the plain prefix, then unquote the rest
+                     char* const begin = w;
+                     std::copy(token_begin, p, w);
+                     w += p - token_begin;
+                     w = unquote(p, end, w);
+                     if (!w) {
+                         return nullptr;
+                     }
+                     tokens_.emplace_back(begin, w - begin);
+                     return w;
+                 });
+}
+
+const std::vector<std::string_view>& Tokenizer::tokens() const {
+    return tokens_;
+}
+
+bool split_in_place(char* begin, char* end, std::vector<std::string_view>& tokens) {
+    return split(begin, end, tokens, [begin, end, &tokens](const char* token_begin, const char*& p) -> const char* {
+        // The plain prefix is already in place: unquote the rest over itself.
+        // Memory is written only from the first removed quote or escape on,
+        // so that untouched pages are never copied on write.
+        char* const w = begin + (p - begin);
+        char* const token_end = unquote(p, end, w);
+        if (!token_end) {
+            return nullptr;
+        }
+        tokens.emplace_back(token_begin, token_end - token_begin);
+        return token_end;
+    });
+}
+} // namespace Args